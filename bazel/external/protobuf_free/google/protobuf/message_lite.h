@@ -0,0 +1,40 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Stands in for protobuf in the protobuf free (--config=lite) build of
+// proxy_wasm_intrinsics, which only declares message helpers that SDK does
+// not call in that build. Every operation fails, so a helper called by
+// mistake reads as an empty message instead of pulling protobuf back in.
+namespace google {
+namespace protobuf {
+
+class MessageLite {
+public:
+  virtual ~MessageLite() = default;
+
+  bool ParseFromArray(const void *, int) { return false; }
+  bool ParseFromString(const std::string &) { return false; }
+  bool SerializeToString(std::string *) const { return false; }
+  std::string SerializeAsString() const { return {}; }
+  size_t ByteSizeLong() const { return 0; }
+};
+
+} // namespace protobuf
+} // namespace google
@@ -61,3 +61,18 @@ def sdk_dependencies():
         ],
         patch_args = ["-p1"],
     )
+
+    http_archive(
+        name = "zlib",
+        build_file = "@istio_wasm_sdk//bazel/external:zlib.BUILD",
+        sha256 = "629380c90a77b964d896ed37163f5c3a34f6e6d897311f1df2a7016355c45eff",
+        strip_prefix = "zlib-1.2.11",
+        urls = ["https://github.com/madler/zlib/archive/v1.2.11.tar.gz"],
+    )
+
+    http_archive(
+        name = "com_google_googletest",
+        sha256 = "9dc9157a9a1551ec7a7e43daea9a694a0bb5fb8bec81235d8a1e6ef64c716dcb",
+        strip_prefix = "googletest-release-1.10.0",
+        urls = ["https://github.com/google/googletest/archive/release-1.10.0.tar.gz"],
+    )
@@ -0,0 +1,136 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/access_log/decoder.h"
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+
+bool RecordDecoder::next(Record *record) {
+  while (!error_ && !input_.empty()) {
+    uint64_t kind = 0;
+    if (!readVarint(&input_, &kind)) {
+      error_ = true;
+      break;
+    }
+    if (static_cast<EntryKind>(kind) != EntryKind::Record) {
+      error_ = !readDefinition(static_cast<EntryKind>(kind));
+      continue;
+    }
+
+    uint64_t flags = 0;
+    uint64_t source_node_id = 0;
+    uint64_t destination_node_id = 0;
+    uint64_t string_ids[5];
+    bool ok = readVarint(&input_, &record->start_time_ns) &&
+              readVarint(&input_, &record->duration_ns) &&
+              readVarint(&input_, &flags) &&
+              readVarint(&input_, &source_node_id) &&
+              readVarint(&input_, &destination_node_id);
+    for (auto &id : string_ids) {
+      ok = ok && readVarint(&input_, &id);
+    }
+    ok = ok && readVarint(&input_, &record->response_code) &&
+         readVarint(&input_, &record->response_flags) &&
+         readVarint(&input_, &record->destination_port) &&
+         readVarint(&input_, &record->request_bytes) &&
+         readVarint(&input_, &record->response_bytes) &&
+         lookupNode(source_node_id, &record->source) &&
+         lookupNode(destination_node_id, &record->destination) &&
+         lookupString(string_ids[0], &record->source_principal) &&
+         lookupString(string_ids[1], &record->destination_principal) &&
+         lookupString(string_ids[2], &record->destination_service_host) &&
+         lookupString(string_ids[3], &record->destination_service_name) &&
+         lookupString(string_ids[4], &record->request_protocol);
+    if (!ok) {
+      error_ = true;
+      break;
+    }
+    record->outbound = flags & kRecordFlagOutbound;
+    record->mutual_tls = flags & kRecordFlagMutualTLS;
+    return true;
+  }
+  return false;
+}
+
+bool RecordDecoder::readDefinition(EntryKind kind) {
+  uint64_t id = 0;
+  switch (kind) {
+  case EntryKind::NodeDefinition: {
+    NodeAttributes node;
+    if (!readVarint(&input_, &id) || !readNode(&input_, &node)) {
+      return false;
+    }
+    nodes_[id] = node;
+    return true;
+  }
+  case EntryKind::StringDefinition: {
+    std::string_view value;
+    if (!readVarint(&input_, &id) || !readString(&input_, &value)) {
+      return false;
+    }
+    strings_[id] = value;
+    return true;
+  }
+  case EntryKind::ResetDictionary:
+    nodes_.clear();
+    strings_.clear();
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+bool RecordDecoder::readNode(std::string_view *input,
+                             NodeAttributes *node) const {
+  return readString(input, &node->name) &&
+         readString(input, &node->namespace_) &&
+         readString(input, &node->workload_name) &&
+         readString(input, &node->owner) &&
+         readString(input, &node->istio_version) &&
+         readString(input, &node->mesh_id);
+}
+
+bool RecordDecoder::lookupNode(uint64_t id, NodeAttributes *node) const {
+  if (id == 0) {
+    *node = NodeAttributes();
+    return true;
+  }
+  auto it = nodes_.find(id);
+  if (it == nodes_.end()) {
+    return false;
+  }
+  *node = it->second;
+  return true;
+}
+
+bool RecordDecoder::lookupString(uint64_t id, std::string_view *value) const {
+  if (id == 0) {
+    *value = std::string_view();
+    return true;
+  }
+  auto it = strings_.find(id);
+  if (it == strings_.end()) {
+    return false;
+  }
+  *value = it->second;
+  return true;
+}
+
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,83 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "istio/extension/access_log/format.h"
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+
+struct NodeAttributes {
+  std::string_view name;
+  std::string_view namespace_;
+  std::string_view workload_name;
+  std::string_view owner;
+  std::string_view istio_version;
+  std::string_view mesh_id;
+};
+
+// A decoded access log record. Views point into the decoded batch, which must
+// outlive the record.
+struct Record {
+  uint64_t start_time_ns = 0;
+  uint64_t duration_ns = 0;
+  bool outbound = false;
+  bool mutual_tls = false;
+  NodeAttributes source;
+  NodeAttributes destination;
+  std::string_view source_principal;
+  std::string_view destination_principal;
+  std::string_view destination_service_host;
+  std::string_view destination_service_name;
+  std::string_view request_protocol;
+  uint64_t response_code = 0;
+  uint64_t response_flags = 0;
+  uint64_t destination_port = 0;
+  uint64_t request_bytes = 0;
+  uint64_t response_bytes = 0;
+};
+
+// RecordDecoder reads records from a batch written by RecordEncoder. It does
+// not depend on the Wasm SDK, so that batches can be decoded offline.
+class RecordDecoder {
+public:
+  explicit RecordDecoder(std::string_view batch) : input_(batch) {}
+
+  // Decodes the next record. Returns false at the end of the batch or if the
+  // batch is malformed, which can be told apart with error().
+  bool next(Record *record);
+
+  bool error() const { return error_; }
+
+private:
+  bool readDefinition(EntryKind kind);
+  bool readNode(std::string_view *input, NodeAttributes *node) const;
+  bool lookupNode(uint64_t id, NodeAttributes *node) const;
+  bool lookupString(uint64_t id, std::string_view *value) const;
+
+  std::string_view input_;
+  bool error_ = false;
+
+  std::unordered_map<uint64_t, NodeAttributes> nodes_;
+  std::unordered_map<uint64_t, std::string_view> strings_;
+};
+
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
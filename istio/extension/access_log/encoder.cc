@@ -0,0 +1,152 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/access_log/encoder.h"
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+
+RecordEncoder::RecordEncoder(size_t max_dictionary_size)
+    : max_dictionary_size_(max_dictionary_size) {}
+
+void RecordEncoder::append(ExtensionStreamContext &stream) {
+  if (!stream.sampled()) {
+    return;
+  }
+  RecordFields fields;
+  fields.source = &stream.sourceNodeInfo();
+  fields.destination = &stream.destinationNodeInfo();
+  fields.source_principal = stream.sourcePrincipal();
+  fields.destination_principal = stream.destinationPrincipal();
+  stream.destinationService(&fields.destination_service_host,
+                            &fields.destination_service_name);
+  fields.request_protocol = stream.requestProtocol();
+  fields.outbound = stream.isOutbound();
+  fields.mutual_tls = stream.serviceAuthenticationPolicy() ==
+                      ServiceAuthenticationPolicy::MutualTLS;
+  fields.response_code = stream.responseCode();
+  fields.destination_port = stream.destinationPort();
+  fields.start_time_ns = stream.requestTime();
+  fields.duration_ns = stream.requestDuration();
+  fields.response_flags = stream.responseFlags();
+  fields.request_bytes = stream.requestTotalSize();
+  fields.response_bytes = stream.responseTotalSize();
+  append(fields);
+}
+
+void RecordEncoder::append(const RecordFields &fields) {
+  maybeResetDictionary();
+
+  // Resolve dictionary ids first, since definitions have to precede the
+  // record which refers to them.
+  auto source_node_id = nodeId(fields.source);
+  auto destination_node_id = nodeId(fields.destination);
+  auto source_principal_id = stringId(fields.source_principal);
+  auto destination_principal_id = stringId(fields.destination_principal);
+  auto service_host_id = stringId(fields.destination_service_host);
+  auto service_name_id = stringId(fields.destination_service_name);
+  auto protocol_id = stringId(fields.request_protocol);
+
+  uint64_t flags = 0;
+  if (fields.outbound) {
+    flags |= kRecordFlagOutbound;
+  }
+  if (fields.mutual_tls) {
+    flags |= kRecordFlagMutualTLS;
+  }
+
+  appendVarint(&buffer_, static_cast<uint64_t>(EntryKind::Record));
+  appendVarint(&buffer_, fields.start_time_ns);
+  appendVarint(&buffer_, fields.duration_ns);
+  appendVarint(&buffer_, flags);
+  appendVarint(&buffer_, source_node_id);
+  appendVarint(&buffer_, destination_node_id);
+  appendVarint(&buffer_, source_principal_id);
+  appendVarint(&buffer_, destination_principal_id);
+  appendVarint(&buffer_, service_host_id);
+  appendVarint(&buffer_, service_name_id);
+  appendVarint(&buffer_, protocol_id);
+  appendVarint(&buffer_, fields.response_code);
+  appendVarint(&buffer_, fields.response_flags);
+  appendVarint(&buffer_, fields.destination_port);
+  appendVarint(&buffer_, fields.request_bytes);
+  appendVarint(&buffer_, fields.response_bytes);
+  record_count_++;
+}
+
+void RecordEncoder::reset() {
+  buffer_.clear();
+  record_count_ = 0;
+  nodes_.clear();
+  strings_.clear();
+}
+
+uint64_t RecordEncoder::nodeId(const istio::extension::NodeInfo *node) {
+  if (node == nullptr || node == &NodeInfo::EmptyNodeInfo) {
+    return 0;
+  }
+  // The lookup key is the encoded definition, which is appended as is on a
+  // miss.
+  lookup_key_.clear();
+  appendString(&lookup_key_, node->name());
+  appendString(&lookup_key_, node->namespace_());
+  appendString(&lookup_key_, node->workload_name());
+  appendString(&lookup_key_, node->owner());
+  appendString(&lookup_key_, node->istio_version());
+  appendString(&lookup_key_, node->mesh_id());
+  auto it = nodes_.find(lookup_key_);
+  if (it != nodes_.end()) {
+    return it->second;
+  }
+  uint64_t id = nodes_.size() + 1;
+  nodes_.emplace(lookup_key_, id);
+  appendVarint(&buffer_, static_cast<uint64_t>(EntryKind::NodeDefinition));
+  appendVarint(&buffer_, id);
+  buffer_.append(lookup_key_);
+  return id;
+}
+
+uint64_t RecordEncoder::stringId(StringView value) {
+  if (value.empty()) {
+    return 0;
+  }
+  lookup_key_.assign(value.data(), value.size());
+  auto it = strings_.find(lookup_key_);
+  if (it != strings_.end()) {
+    return it->second;
+  }
+  uint64_t id = strings_.size() + 1;
+  strings_.emplace(lookup_key_, id);
+  appendVarint(&buffer_, static_cast<uint64_t>(EntryKind::StringDefinition));
+  appendVarint(&buffer_, id);
+  appendString(&buffer_, value);
+  return id;
+}
+
+void RecordEncoder::maybeResetDictionary() {
+  // A record defines at most two nodes and five strings.
+  if (nodes_.size() + 2 <= max_dictionary_size_ &&
+      strings_.size() + 6 <= max_dictionary_size_) {
+    return;
+  }
+  nodes_.clear();
+  strings_.clear();
+  appendVarint(&buffer_, static_cast<uint64_t>(EntryKind::ResetDictionary));
+}
+
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
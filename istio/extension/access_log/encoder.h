@@ -0,0 +1,99 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "istio/extension/access_log/format.h"
+#include "istio/extension/extension.h"
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+
+const size_t DefaultMaxDictionarySize = 1000;
+
+// Attributes of one record, as gathered from a stream. Views must stay valid
+// until the record is appended.
+struct RecordFields {
+  int64_t start_time_ns = 0;
+  int64_t duration_ns = 0;
+  bool outbound = false;
+  bool mutual_tls = false;
+  // EmptyNodeInfo or nullptr for an unknown node.
+  const istio::extension::NodeInfo *source = nullptr;
+  const istio::extension::NodeInfo *destination = nullptr;
+  StringView source_principal;
+  StringView destination_principal;
+  StringView destination_service_host;
+  StringView destination_service_name;
+  StringView request_protocol;
+  int64_t response_code = 0;
+  uint64_t response_flags = 0;
+  int64_t destination_port = 0;
+  int64_t request_bytes = 0;
+  int64_t response_bytes = 0;
+};
+
+// RecordEncoder writes access log records of streams into a reusable buffer
+// in the compact binary format described in format.h. Node attributes are
+// defined once per batch for each distinct node and then referred to by id,
+// as are principals, service names and protocols. It is meant to be owned by
+// a root context, and to be fed from stream onLog.
+class RecordEncoder {
+public:
+  explicit RecordEncoder(size_t max_dictionary_size = DefaultMaxDictionarySize);
+
+  // Appends a record of the stream. Should be called at onLog. Unsampled
+  // streams are skipped.
+  void append(ExtensionStreamContext &stream);
+
+  // Appends a record of the given attributes.
+  void append(const RecordFields &fields);
+
+  // Encoded batch. Stays valid until the next append or reset.
+  const std::string &buffer() const { return buffer_; }
+
+  size_t recordCount() const { return record_count_; }
+
+  // Starts a new self-contained batch. Buffer capacity is kept for reuse.
+  void reset();
+
+private:
+  uint64_t nodeId(const istio::extension::NodeInfo *node);
+  uint64_t stringId(StringView value);
+
+  // Drops dictionaries once they are full, and tells decoders to do the same.
+  void maybeResetDictionary();
+
+  size_t max_dictionary_size_;
+  std::string buffer_;
+  size_t record_count_ = 0;
+
+  // Nodes are keyed by their encoded definition rather than by address, as
+  // a node info cache entry can be freed and another node allocated at the
+  // same address, e.g. when a pod is rescheduled.
+  std::unordered_map<std::string, uint64_t> nodes_;
+  std::unordered_map<std::string, uint64_t> strings_;
+
+  // Scratch key of dictionary lookups, so that a lookup hit does not
+  // allocate.
+  std::string lookup_key_;
+};
+
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
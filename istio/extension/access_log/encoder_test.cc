@@ -0,0 +1,235 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/access_log/decoder.h"
+#include "istio/extension/access_log/encoder.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswer;
+using Replay::HostAnswers;
+
+istio::extension::NodeInfo makeNode(const std::string &name,
+                                    const std::string &namespace_) {
+  istio::extension::NodeInfo node;
+  node.set_name(name);
+  node.set_namespace_(namespace_);
+  node.set_workload_name("reviews-v1");
+  node.set_owner("kubernetes://apis/apps/v1/namespaces/default/reviews-v1");
+  node.set_istio_version("1.8.0");
+  node.set_mesh_id("mesh");
+  return node;
+}
+
+std::string path(std::initializer_list<StringView> parts) {
+  std::string result;
+  for (auto part : parts) {
+    if (!result.empty()) {
+      result.push_back('\0');
+    }
+    result.append(part.data(), part.size());
+  }
+  return result;
+}
+
+template <typename T> std::string bytes(T value) {
+  return std::string(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Serializes pairs as host does.
+std::string serializePairs(
+    const std::vector<std::pair<std::string, std::string>> &pairs) {
+  std::string out;
+  uint32_t count = pairs.size();
+  out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const auto &pair : pairs) {
+    uint32_t sizes[] = {static_cast<uint32_t>(pair.first.size()),
+                        static_cast<uint32_t>(pair.second.size())};
+    out.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  }
+  for (const auto &pair : pairs) {
+    out.append(pair.first);
+    out.push_back('\0');
+    out.append(pair.second);
+    out.push_back('\0');
+  }
+  return out;
+}
+
+TEST(RecordEncoderTest, RoundTrip) {
+  auto source = makeNode("productpage-1", "default");
+  auto destination = makeNode("reviews-1", "default");
+  RecordFields fields;
+  fields.start_time_ns = 1600000000000000000;
+  fields.duration_ns = 1500000;
+  fields.outbound = true;
+  fields.mutual_tls = true;
+  fields.source = &source;
+  fields.destination = &destination;
+  fields.source_principal = "spiffe://cluster.local/ns/default/sa/productpage";
+  fields.destination_principal = "spiffe://cluster.local/ns/default/sa/reviews";
+  fields.destination_service_host = "reviews.default.svc.cluster.local";
+  fields.destination_service_name = "reviews";
+  fields.request_protocol = "http";
+  fields.response_code = 200;
+  fields.response_flags = 0x10;
+  fields.destination_port = 9080;
+  fields.request_bytes = 120;
+  fields.response_bytes = 3400;
+
+  RecordEncoder encoder;
+  encoder.append(fields);
+  fields.response_code = 503;
+  fields.source = nullptr;
+  encoder.append(fields);
+  EXPECT_EQ(2, encoder.recordCount());
+
+  RecordDecoder decoder(encoder.buffer());
+  Record record;
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ(1600000000000000000u, record.start_time_ns);
+  EXPECT_EQ(1500000u, record.duration_ns);
+  EXPECT_TRUE(record.outbound);
+  EXPECT_TRUE(record.mutual_tls);
+  EXPECT_EQ("productpage-1", record.source.name);
+  EXPECT_EQ("default", record.source.namespace_);
+  EXPECT_EQ("reviews-v1", record.source.workload_name);
+  EXPECT_EQ("1.8.0", record.source.istio_version);
+  EXPECT_EQ("mesh", record.source.mesh_id);
+  EXPECT_EQ("reviews-1", record.destination.name);
+  EXPECT_EQ("spiffe://cluster.local/ns/default/sa/productpage",
+            record.source_principal);
+  EXPECT_EQ("spiffe://cluster.local/ns/default/sa/reviews",
+            record.destination_principal);
+  EXPECT_EQ("reviews.default.svc.cluster.local",
+            record.destination_service_host);
+  EXPECT_EQ("reviews", record.destination_service_name);
+  EXPECT_EQ("http", record.request_protocol);
+  EXPECT_EQ(200u, record.response_code);
+  EXPECT_EQ(0x10u, record.response_flags);
+  EXPECT_EQ(9080u, record.destination_port);
+  EXPECT_EQ(120u, record.request_bytes);
+  EXPECT_EQ(3400u, record.response_bytes);
+
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ(503u, record.response_code);
+  EXPECT_EQ("", record.source.name);
+  EXPECT_EQ("reviews-1", record.destination.name);
+  EXPECT_FALSE(decoder.next(&record));
+  EXPECT_FALSE(decoder.error());
+}
+
+// A node freed and another allocated at the same address must not be
+// reported with the definition of the former.
+TEST(RecordEncoderTest, NodeReusedAtSameAddress) {
+  auto node = makeNode("reviews-1", "default");
+  RecordFields fields;
+  fields.source = &node;
+  fields.destination = &node;
+
+  RecordEncoder encoder;
+  encoder.append(fields);
+  node = makeNode("reviews-1", "staging");
+  encoder.append(fields);
+  auto size = encoder.buffer().size();
+  encoder.append(fields);
+  // The second definition is reused rather than redefined.
+  EXPECT_GT(size + 32, encoder.buffer().size());
+
+  RecordDecoder decoder(encoder.buffer());
+  Record record;
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ("default", record.source.namespace_);
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ("staging", record.source.namespace_);
+  EXPECT_EQ("staging", record.destination.namespace_);
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ("staging", record.source.namespace_);
+  EXPECT_FALSE(decoder.next(&record));
+  EXPECT_FALSE(decoder.error());
+}
+
+TEST(RecordEncoderTest, ResetStartsSelfContainedBatch) {
+  auto node = makeNode("reviews-1", "default");
+  RecordFields fields;
+  fields.destination = &node;
+  fields.request_protocol = "grpc";
+
+  RecordEncoder encoder;
+  encoder.append(fields);
+  encoder.reset();
+  encoder.append(fields);
+  EXPECT_EQ(1, encoder.recordCount());
+
+  RecordDecoder decoder(encoder.buffer());
+  Record record;
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ("reviews-1", record.destination.name);
+  EXPECT_EQ("grpc", record.request_protocol);
+  EXPECT_FALSE(decoder.next(&record));
+  EXPECT_FALSE(decoder.error());
+}
+
+TEST(RecordEncoderTest, AppendsStream) {
+  FakeHost::get().reset();
+  HostAnswers answers;
+  answers[path({"request", "time"})] = {true,
+                                        bytes<int64_t>(1600000000000000000)};
+  answers[path({"request", "duration"})] = {true, bytes<int64_t>(1500000)};
+  answers[path({"request", "total_size"})] = {true, bytes<int64_t>(120)};
+  answers["response"] = {
+      true, serializePairs({{"code", bytes<int64_t>(503)},
+                            {"flags", bytes<uint64_t>(0x10)},
+                            {"total_size", bytes<int64_t>(3400)}})};
+  FakeHost::get().setStreamAnswers(&answers);
+
+  ExtensionRootContext root(1, "");
+  ExtensionStreamContext stream(2, &root);
+  RecordEncoder encoder;
+  encoder.append(stream);
+  // Response flags were read along with the code, and are not read again.
+  auto calls = stream.attributes().hostCalls();
+  EXPECT_EQ("UR", stream.responseFlag());
+  EXPECT_EQ(calls, stream.attributes().hostCalls());
+  FakeHost::get().setStreamAnswers(nullptr);
+
+  RecordDecoder decoder(encoder.buffer());
+  Record record;
+  ASSERT_TRUE(decoder.next(&record));
+  EXPECT_EQ(1600000000000000000u, record.start_time_ns);
+  EXPECT_EQ(1500000u, record.duration_ns);
+  EXPECT_EQ(503u, record.response_code);
+  EXPECT_EQ(0x10u, record.response_flags);
+  EXPECT_EQ(120u, record.request_bytes);
+  EXPECT_EQ(3400u, record.response_bytes);
+  EXPECT_FALSE(decoder.next(&record));
+  EXPECT_FALSE(decoder.error());
+}
+
+} // namespace
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
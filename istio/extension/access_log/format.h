@@ -0,0 +1,96 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Compact binary access log format.
+//
+// A batch is a sequence of entries, each starting with a varint entry kind.
+// Repeated node attributes and strings are dictionary encoded: they are
+// defined once per batch and then referred to by id. Id 0 always refers to
+// an empty node or an empty string.
+//
+//   NodeDefinition:   id, name, namespace, workload_name, owner,
+//                     istio_version, mesh_id
+//   StringDefinition: id, value
+//   Record:           start_time_ns, duration_ns, flags, source_node_id,
+//                     destination_node_id, source_principal_id,
+//                     destination_principal_id, destination_service_host_id,
+//                     destination_service_name_id, request_protocol_id,
+//                     response_code, response_flags, destination_port,
+//                     request_bytes, response_bytes
+//   ResetDictionary:  no payload, drops all definitions seen so far.
+//
+// Integers are varints, strings are a varint length followed by the bytes.
+
+namespace Istio {
+namespace Extension {
+namespace AccessLog {
+
+enum class EntryKind : uint8_t {
+  NodeDefinition = 1,
+  StringDefinition = 2,
+  Record = 3,
+  ResetDictionary = 4,
+};
+
+// Bits of the record flags field.
+constexpr uint64_t kRecordFlagOutbound = 0x1;
+constexpr uint64_t kRecordFlagMutualTLS = 0x2;
+
+inline void appendVarint(std::string *out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+inline void appendString(std::string *out, std::string_view value) {
+  appendVarint(out, value.size());
+  out->append(value.data(), value.size());
+}
+
+// Reads a varint from the front of input. Returns false on truncated input.
+inline bool readVarint(std::string_view *input, uint64_t *value) {
+  *value = 0;
+  for (size_t i = 0; i < input->size() && i < 10; i++) {
+    auto byte = static_cast<uint8_t>((*input)[i]);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      input->remove_prefix(i + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool readString(std::string_view *input, std::string_view *value) {
+  uint64_t size = 0;
+  if (!readVarint(input, &size) || size > input->size()) {
+    return false;
+  }
+  *value = input->substr(0, size);
+  input->remove_prefix(size);
+  return true;
+}
+
+} // namespace AccessLog
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,187 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/attributes.h"
+
+#include "istio/extension/util/host_trace.h"
+#include "istio/extension/util/util.h"
+
+namespace Istio {
+namespace Extension {
+
+namespace {
+
+struct AttributePath {
+  // Parent map, or empty for a top level attribute.
+  StringView parent;
+  StringView name;
+  // Whether the attribute is fetched with its siblings. Connection id is
+  // not, as every stream reads it, while the rest of the connection map is
+  // only needed by the first stream of a connection.
+  bool batched;
+  // Size of a numeric value, which host serializes as its bytes, or 0.
+  size_t size;
+};
+
+constexpr AttributePath kAttributePaths[kAttributeCount] = {
+    {"", "listener_direction", false, 0},
+    {"destination", "port", false, sizeof(int64_t)},
+    {"connection", "id", false, sizeof(uint64_t)},
+    {"connection", "mtls", true, sizeof(bool)},
+    {"connection", "uri_san_peer_certificate", true, 0},
+    {"connection", "uri_san_local_certificate", true, 0},
+    {"upstream", "port", true, sizeof(int64_t)},
+    {"upstream", "uri_san_peer_certificate", true, 0},
+    {"upstream", "uri_san_local_certificate", true, 0},
+    {"", "cluster_name", false, 0},
+    {"", "route_name", false, 0},
+    {"response", "code", true, sizeof(int64_t)},
+    {"response", "flags", true, sizeof(uint64_t)},
+    {"response", "total_size", true, sizeof(int64_t)},
+    {"request", "time", false, sizeof(int64_t)},
+    {"request", "duration", false, sizeof(int64_t)},
+    {"request", "total_size", false, sizeof(int64_t)},
+};
+
+const AttributePath &attributePath(Attribute attribute) {
+  return kAttributePaths[static_cast<size_t>(attribute)];
+}
+
+// Batched attributes sharing the parent of the given one.
+AttributeSet siblings(Attribute attribute) {
+  const auto &path = attributePath(attribute);
+  AttributeSet set = 0;
+  for (size_t i = 0; i < kAttributeCount; i++) {
+    const auto &sibling = kAttributePaths[i];
+    if (sibling.batched && sibling.parent == path.parent) {
+      set |= attributeSet(static_cast<Attribute>(i));
+    }
+  }
+  return set;
+}
+
+uint32_t count(AttributeSet set) { return __builtin_popcount(set); }
+
+} // namespace
+
+void AttributePrefetch::record(uint32_t host_calls, uint32_t calls_saved) {
+  if (host_calls == 0) {
+    return;
+  }
+  stats_.requests++;
+  stats_.host_calls += host_calls;
+  stats_.calls_saved += calls_saved;
+}
+
+bool Attributes::get(Attribute attribute, StringView *value) {
+  auto bit = attributeSet(attribute);
+  if ((fetched_ & bit) == 0) {
+    fetch(attribute);
+  }
+  if ((found_ & bit) == 0) {
+    return false;
+  }
+  if ((from_parent_ & bit) != 0) {
+    used_from_parent_ |= bit;
+  }
+  *value = values_[static_cast<size_t>(attribute)];
+  return true;
+}
+
+uint32_t Attributes::callsSaved() const {
+  auto used = count(used_from_parent_);
+  return used > parent_reads_ ? used - parent_reads_ : 0;
+}
+
+void Attributes::fetch(Attribute attribute) {
+  if (attributePath(attribute).batched && prefetch_->parentReads()) {
+    // A parent read only pays off for at least two attributes.
+    auto group = siblings(attribute) & prefetch_->declared() & ~fetched_;
+    group |= attributeSet(attribute);
+    if (count(group) > 1 && fetchParent(attribute, group)) {
+      return;
+    }
+  }
+  fetchOne(attribute);
+}
+
+bool Attributes::fetchParent(Attribute attribute, AttributeSet group) {
+  const auto &parent = attributePath(attribute).parent;
+  WasmDataPtr data;
+  auto result = Util::readProperty(parent, &data);
+  host_calls_++;
+  if (result == WasmResult::NotFound) {
+    // Parent is not available yet, and neither are its attributes.
+    return true;
+  }
+  // Values are only cached once the whole parent is decoded, so that a
+  // parent in an unexpected format leaves nothing behind.
+  AttributeSet found = 0;
+  bool numeric = true;
+  bool pairs =
+      result == WasmResult::Ok &&
+      Util::forEachPair(data->view(), [this, group, &found, &numeric](
+                                          StringView key, StringView value) {
+        for (size_t i = 0; i < kAttributeCount; i++) {
+          auto bit = attributeSet(static_cast<Attribute>(i));
+          const auto &path = kAttributePaths[i];
+          if ((group & bit) != 0 && path.name == key) {
+            if (path.size != 0 && value.size() != path.size) {
+              numeric = false;
+            }
+            values_[i] = value;
+            found |= bit;
+            break;
+          }
+        }
+      });
+  if (!pairs || !numeric) {
+    LOG_DEBUG("cannot read " + std::string(parent) +
+              " as a whole, reading attributes one by one: " +
+              (result != WasmResult::Ok ? toString(result)
+                                        : std::string("unexpected format")));
+    prefetch_->disableParentReads();
+    return false;
+  }
+  parent_reads_++;
+  // Attributes missing from the parent are not cached, as host may set them
+  // later in the stream, e.g. response code once the response starts.
+  fetched_ |= found;
+  found_ |= found;
+  from_parent_ |= found;
+  if (found != 0) {
+    buffers_[buffer_count_++] = std::move(data);
+  }
+  return true;
+}
+
+void Attributes::fetchOne(Attribute attribute) {
+  const auto &path = attributePath(attribute);
+  auto value = path.parent.empty()
+                   ? Util::readProperty({path.name})
+                   : Util::readProperty({path.parent, path.name});
+  host_calls_++;
+  if (!value) {
+    return;
+  }
+  auto bit = attributeSet(attribute);
+  values_[static_cast<size_t>(attribute)] = (*value)->view();
+  fetched_ |= bit;
+  found_ |= bit;
+  buffers_[buffer_count_++] = std::move(*value);
+}
+
+} // namespace Extension
+} // namespace Istio
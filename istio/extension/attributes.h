@@ -0,0 +1,156 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+
+// Host attributes read by stream and network contexts.
+enum class Attribute : uint8_t {
+  ListenerDirection = 0,
+  DestinationPort,
+  ConnectionId,
+  ConnectionMtls,
+  ConnectionPeerPrincipal,
+  ConnectionLocalPrincipal,
+  UpstreamPort,
+  UpstreamPeerPrincipal,
+  UpstreamLocalPrincipal,
+  ClusterName,
+  RouteName,
+  ResponseCode,
+  ResponseFlags,
+  ResponseTotalSize,
+  RequestTime,
+  RequestDuration,
+  RequestTotalSize,
+};
+
+constexpr size_t kAttributeCount =
+    static_cast<size_t>(Attribute::RequestTotalSize) + 1;
+
+// Bitmask of attributes.
+typedef uint32_t AttributeSet;
+
+constexpr AttributeSet attributeSet(Attribute attribute) {
+  return AttributeSet(1) << static_cast<uint32_t>(attribute);
+}
+
+constexpr AttributeSet kAllAttributes =
+    (AttributeSet(1) << kAttributeCount) - 1;
+
+struct AttributePrefetchStats {
+  // Streams which read attributes, and host calls they made.
+  uint64_t requests = 0;
+  uint64_t host_calls = 0;
+  // Host calls saved by reading parent properties, compared to reading each
+  // attribute on its own.
+  uint64_t calls_saved = 0;
+};
+
+// AttributePrefetch holds the attributes a plugin declared at configure time,
+// and is shared by all streams of a root context. Declared attributes with a
+// common parent, e.g. upstream.port and upstream.uri_san_peer_certificate,
+// are fetched together by a single read of the parent map, connection,
+// upstream or response, which host returns serialized as pairs with numeric
+// values as their bytes. A host which cannot serialize maps, or serializes
+// them otherwise, is detected on the first parent read of a root context,
+// after which attributes are read one by one.
+class AttributePrefetch {
+public:
+  void declare(AttributeSet attributes) { declared_ = attributes; }
+  AttributeSet declared() const { return declared_; }
+
+  bool parentReads() const { return parent_reads_; }
+  void disableParentReads() { parent_reads_ = false; }
+
+  void record(uint32_t host_calls, uint32_t calls_saved);
+  const AttributePrefetchStats &stats() const { return stats_; }
+
+  // Average number of host calls saved per request.
+  double callsSavedPerRequest() const {
+    return stats_.requests == 0
+               ? 0
+               : static_cast<double>(stats_.calls_saved) / stats_.requests;
+  }
+
+private:
+  AttributeSet declared_ = kAllAttributes;
+  bool parent_reads_ = true;
+  AttributePrefetchStats stats_;
+};
+
+// Attributes caches attribute values of one stream or connection. Values are
+// views into host buffers owned by it, so they are valid for its lifetime.
+//
+// An attribute is fetched on first access, along with the other declared and
+// not yet fetched attributes of the same parent. Only attributes found are
+// cached: if the parent is not available yet, e.g. upstream before the
+// request is routed, or an attribute is missing from it, e.g. response code
+// before the response, the next access reads it again.
+class Attributes {
+public:
+  explicit Attributes(AttributePrefetch *prefetch) : prefetch_(prefetch) {}
+
+  bool get(Attribute attribute, StringView *value);
+
+  // Gets a numeric attribute, which host serializes as its bytes.
+  template <typename T> bool get(Attribute attribute, T *value) {
+    static_assert(std::is_arithmetic<T>::value, "unsupported attribute type");
+    StringView data;
+    if (!get(attribute, &data) || data.size() != sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, data.data(), sizeof(T));
+    return true;
+  }
+
+  uint32_t hostCalls() const { return host_calls_; }
+
+  // Host calls saved so far, i.e. attributes served from parent reads which
+  // would have been read on their own, less the parent reads.
+  uint32_t callsSaved() const;
+
+private:
+  void fetch(Attribute attribute);
+  bool fetchParent(Attribute attribute, AttributeSet group);
+  void fetchOne(Attribute attribute);
+
+  AttributePrefetch *prefetch_;
+  std::array<StringView, kAttributeCount> values_;
+  AttributeSet fetched_ = 0;
+  AttributeSet found_ = 0;
+  // Attributes decoded from parent reads, and those of them accessed.
+  AttributeSet from_parent_ = 0;
+  AttributeSet used_from_parent_ = 0;
+  uint32_t host_calls_ = 0;
+  uint32_t parent_reads_ = 0;
+  // Host buffers values point into. Every buffer kept holds at least one
+  // attribute found for the first time, so there are at most as many buffers
+  // as attributes, and keeping them never allocates.
+  std::array<WasmDataPtr, kAttributeCount> buffers_;
+  size_t buffer_count_ = 0;
+};
+
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,228 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "istio/extension/attributes.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswer;
+using Replay::HostAnswers;
+
+typedef std::vector<std::pair<std::string, std::string>> Pairs;
+
+std::string path(std::initializer_list<StringView> parts) {
+  std::string result;
+  for (auto part : parts) {
+    if (!result.empty()) {
+      result.push_back('\0');
+    }
+    result.append(part.data(), part.size());
+  }
+  return result;
+}
+
+template <typename T> std::string bytes(T value) {
+  return std::string(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Serializes pairs as host does.
+std::string serializePairs(const Pairs &pairs) {
+  std::string out;
+  uint32_t count = pairs.size();
+  out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const auto &pair : pairs) {
+    uint32_t sizes[] = {static_cast<uint32_t>(pair.first.size()),
+                        static_cast<uint32_t>(pair.second.size())};
+    out.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  }
+  for (const auto &pair : pairs) {
+    out.append(pair.first);
+    out.push_back('\0');
+    out.append(pair.second);
+    out.push_back('\0');
+  }
+  return out;
+}
+
+class AttributesTest : public testing::Test {
+protected:
+  void SetUp() override {
+    FakeHost::get().reset();
+    FakeHost::get().resetCounters();
+    FakeHost::get().setStreamAnswers(&answers_);
+  }
+  void TearDown() override { FakeHost::get().setStreamAnswers(nullptr); }
+
+  uint64_t hostReads() const { return FakeHost::get().counters().reads; }
+
+  HostAnswers answers_;
+  AttributePrefetch prefetch_;
+};
+
+TEST_F(AttributesTest, ReadsSiblingsThroughParent) {
+  answers_["response"] = {
+      true, serializePairs({{"code", bytes<int64_t>(200)},
+                            {"flags", bytes<uint64_t>(0)},
+                            {"total_size", bytes<int64_t>(480)}})};
+  Attributes attributes(&prefetch_);
+  int64_t code = 0;
+  uint64_t flags = 1;
+  int64_t size = 0;
+  EXPECT_TRUE(attributes.get(Attribute::ResponseCode, &code));
+  EXPECT_TRUE(attributes.get(Attribute::ResponseFlags, &flags));
+  EXPECT_TRUE(attributes.get(Attribute::ResponseTotalSize, &size));
+  EXPECT_EQ(200, code);
+  EXPECT_EQ(0, flags);
+  EXPECT_EQ(480, size);
+  EXPECT_EQ(1, hostReads());
+  EXPECT_EQ(1, attributes.hostCalls());
+  EXPECT_EQ(2, attributes.callsSaved());
+}
+
+TEST_F(AttributesTest, ReadsAgainAttributeMissingFromParent) {
+  // Flags are set before the response starts, the code is not.
+  answers_["response"] = {true,
+                          serializePairs({{"flags", bytes<uint64_t>(0)}})};
+  Attributes attributes(&prefetch_);
+  int64_t code = 0;
+  uint64_t flags = 1;
+  EXPECT_FALSE(attributes.get(Attribute::ResponseCode, &code));
+  EXPECT_TRUE(attributes.get(Attribute::ResponseFlags, &flags));
+  EXPECT_EQ(1, hostReads());
+
+  answers_["response"] = {true,
+                          serializePairs({{"code", bytes<int64_t>(503)},
+                                          {"flags", bytes<uint64_t>(16)}})};
+  answers_[path({"response", "code"})] = {true, bytes<int64_t>(503)};
+  EXPECT_TRUE(attributes.get(Attribute::ResponseCode, &code));
+  EXPECT_EQ(503, code);
+  // Flags found before stay cached.
+  EXPECT_TRUE(attributes.get(Attribute::ResponseFlags, &flags));
+  EXPECT_EQ(0, flags);
+  EXPECT_EQ(2, hostReads());
+}
+
+TEST_F(AttributesTest, ReadsAgainMissingParent) {
+  Attributes attributes(&prefetch_);
+  StringView principal;
+  EXPECT_FALSE(attributes.get(Attribute::UpstreamPeerPrincipal, &principal));
+
+  // Upstream is known once the request is routed.
+  answers_["upstream"] = {
+      true, serializePairs({{"port", bytes<int64_t>(8080)},
+                            {"uri_san_peer_certificate", "spiffe://a"},
+                            {"uri_san_local_certificate", "spiffe://b"}})};
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamPeerPrincipal, &principal));
+  EXPECT_EQ("spiffe://a", principal);
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamLocalPrincipal, &principal));
+  EXPECT_EQ("spiffe://b", principal);
+  EXPECT_EQ(2, attributes.hostCalls());
+  EXPECT_TRUE(prefetch_.parentReads());
+}
+
+TEST_F(AttributesTest, SerializationFailureFallsBackToSingleReads) {
+  answers_["upstream"].failure = WasmResult::SerializationFailure;
+  answers_[path({"upstream", "port"})] = {true, bytes<int64_t>(8080)};
+  answers_[path({"upstream", "uri_san_peer_certificate"})] = {true,
+                                                              "spiffe://a"};
+  Attributes attributes(&prefetch_);
+  int64_t port = 0;
+  StringView principal;
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamPort, &port));
+  EXPECT_EQ(8080, port);
+  EXPECT_FALSE(prefetch_.parentReads());
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamPeerPrincipal, &principal));
+  EXPECT_EQ("spiffe://a", principal);
+  // The failed parent read is made once per root context.
+  EXPECT_EQ(3, attributes.hostCalls());
+  EXPECT_EQ(0, attributes.callsSaved());
+
+  Attributes next(&prefetch_);
+  EXPECT_TRUE(next.get(Attribute::UpstreamPort, &port));
+  EXPECT_EQ(1, next.hostCalls());
+}
+
+TEST_F(AttributesTest, TextNumericValueFallsBackToSingleReads) {
+  answers_["response"] = {true, serializePairs({{"code", "200"},
+                                                {"flags", "0"}})};
+  answers_[path({"response", "code"})] = {true, bytes<int64_t>(200)};
+  Attributes attributes(&prefetch_);
+  int64_t code = 0;
+  EXPECT_TRUE(attributes.get(Attribute::ResponseCode, &code));
+  EXPECT_EQ(200, code);
+  EXPECT_FALSE(prefetch_.parentReads());
+  EXPECT_EQ(2, attributes.hostCalls());
+}
+
+TEST_F(AttributesTest, MalformedParentFallsBackToSingleReads) {
+  answers_["response"] = {true, std::string("\x05\x00\x00\x00", 4)};
+  answers_[path({"response", "code"})] = {true, bytes<int64_t>(200)};
+  Attributes attributes(&prefetch_);
+  int64_t code = 0;
+  EXPECT_TRUE(attributes.get(Attribute::ResponseCode, &code));
+  EXPECT_EQ(200, code);
+  EXPECT_FALSE(prefetch_.parentReads());
+}
+
+TEST_F(AttributesTest, NumericSizeMismatchIsNotFound) {
+  answers_[path({"request", "duration"})] = {true, "25"};
+  Attributes attributes(&prefetch_);
+  int64_t duration = 0;
+  EXPECT_FALSE(attributes.get(Attribute::RequestDuration, &duration));
+  EXPECT_EQ(0, duration);
+}
+
+TEST_F(AttributesTest, OutboundAccessorHostCalls) {
+  answers_["upstream"] = {
+      true, serializePairs({{"port", bytes<int64_t>(8080)},
+                            {"uri_san_peer_certificate", "spiffe://a"},
+                            {"uri_san_local_certificate", "spiffe://b"}})};
+  answers_["response"] = {true,
+                          serializePairs({{"code", bytes<int64_t>(200)},
+                                          {"flags", bytes<uint64_t>(0)}})};
+  answers_["cluster_name"] = {true, "outbound|8080||b"};
+  answers_["route_name"] = {true, "default"};
+  prefetch_.declare(kAllAttributes &
+                    ~attributeSet(Attribute::ResponseTotalSize));
+  Attributes attributes(&prefetch_);
+  int64_t number = 0;
+  uint64_t flags = 0;
+  StringView value;
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamPort, &number));
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamPeerPrincipal, &value));
+  EXPECT_TRUE(attributes.get(Attribute::UpstreamLocalPrincipal, &value));
+  EXPECT_TRUE(attributes.get(Attribute::ResponseCode, &number));
+  EXPECT_TRUE(attributes.get(Attribute::ResponseFlags, &flags));
+  EXPECT_TRUE(attributes.get(Attribute::ClusterName, &value));
+  EXPECT_TRUE(attributes.get(Attribute::RouteName, &value));
+  // Read one by one, the same attributes take seven host calls.
+  EXPECT_EQ(4, attributes.hostCalls());
+  EXPECT_EQ(3, attributes.callsSaved());
+}
+
+} // namespace
+} // namespace Extension
+} // namespace Istio
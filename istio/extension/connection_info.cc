@@ -0,0 +1,94 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/connection_info.h"
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+
+ConnectionInfoPtr fetchConnectionInfo(Attributes *attributes) {
+  auto info = std::make_shared<ConnectionInfo>();
+  int64_t direction = 0;
+  if (attributes->get(Attribute::ListenerDirection, &direction)) {
+    info->direction = static_cast<TrafficDirection>(direction);
+  }
+  attributes->get(Attribute::DestinationPort, &info->destination_port);
+  attributes->get(Attribute::ConnectionMtls, &info->mtls);
+  StringView principal;
+  if (attributes->get(Attribute::ConnectionPeerPrincipal, &principal)) {
+    info->peer_principal.assign(principal.data(), principal.size());
+  }
+  if (attributes->get(Attribute::ConnectionLocalPrincipal, &principal)) {
+    info->local_principal.assign(principal.data(), principal.size());
+  }
+  return info;
+}
+
+ConnectionInfoPtr ConnectionInfoCache::acquire(uint64_t connection_id,
+                                               Attributes *attributes) {
+  auto &entry = cache_[connection_id];
+  if (!entry.info) {
+    entry.info = fetchConnectionInfo(attributes);
+  } else if (entry.active_streams == 0) {
+    idle_entries_--;
+  }
+  entry.active_streams++;
+  return entry.info;
+}
+
+void ConnectionInfoCache::release(uint64_t connection_id,
+                                  const ConnectionInfoPtr &info) {
+  auto it = cache_.find(connection_id);
+  if (it == cache_.end() || it->second.info != info ||
+      it->second.active_streams == 0) {
+    return;
+  }
+  auto &entry = it->second;
+  if (--entry.active_streams == 0) {
+    entry.released_at = ++releases_;
+    if (++idle_entries_ > max_idle_entries_) {
+      evictIdle();
+    }
+  }
+}
+
+void ConnectionInfoCache::remove(uint64_t connection_id) {
+  auto it = cache_.find(connection_id);
+  if (it == cache_.end()) {
+    return;
+  }
+  if (it->second.active_streams == 0) {
+    idle_entries_--;
+  }
+  cache_.erase(it);
+}
+
+void ConnectionInfoCache::evictIdle() {
+  uint64_t keep = max_idle_entries_ / 2;
+  uint64_t cutoff = releases_ > keep ? releases_ - keep : 0;
+  for (auto it = cache_.begin(); it != cache_.end();) {
+    if (it->second.active_streams == 0 && it->second.released_at <= cutoff) {
+      it = cache_.erase(it);
+      idle_entries_--;
+    } else {
+      ++it;
+    }
+  }
+}
+
+} // namespace Extension
+} // namespace Istio
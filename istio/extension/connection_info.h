@@ -0,0 +1,102 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "istio/extension/attributes.h"
+#include "istio/extension/node_info/node_info.h"
+#include "istio/extension/util/util.h"
+
+namespace Istio {
+namespace Extension {
+
+// ConnectionInfo holds attributes which are fixed for the lifetime of a
+// downstream connection, and thus are shared by all streams multiplexed on it.
+struct ConnectionInfo {
+  TrafficDirection direction = TrafficDirection::Unspecified;
+
+  // Local port which accepted the downstream connection.
+  int64_t destination_port = 0;
+
+  // Whether the downstream connection is mTLS.
+  bool mtls = false;
+
+  // URI SAN of the downstream peer certificate and local certificate.
+  std::string peer_principal;
+  std::string local_principal;
+
+  // Node info of the downstream peer. This is resolved lazily by the first
+  // stream which has peer metadata available, and stays empty until then.
+  NodeInfo::NodeInfoPtr peer_node_info;
+};
+
+typedef std::shared_ptr<ConnectionInfo> ConnectionInfoPtr;
+
+// Fetches attributes of the current downstream connection from host.
+ConnectionInfoPtr fetchConnectionInfo(Attributes *attributes);
+
+const size_t DefaultConnectionInfoCacheMaxIdleEntries = 1000;
+
+// ConnectionInfoCache keeps connection attributes keyed by downstream
+// connection id. An entry is created by the first stream of a connection, and
+// is kept until the connection closes, so that sequential streams on a
+// keep-alive connection share it too. As HTTP filters are not told about
+// closed connections, entries without active streams are also evicted least
+// recently released first once there are more than max_idle_entries of them.
+class ConnectionInfoCache {
+public:
+  explicit ConnectionInfoCache(
+      size_t max_idle_entries = DefaultConnectionInfoCacheMaxIdleEntries)
+      : max_idle_entries_(max_idle_entries) {}
+
+  // Gets connection info of the given connection, and fetches it from host
+  // through the attributes of the calling stream if it is not cached.
+  ConnectionInfoPtr acquire(uint64_t connection_id, Attributes *attributes);
+
+  // Releases a reference taken by acquire, which returned info. References
+  // to an entry which was removed in the meantime are ignored, so that they
+  // do not release a newer entry of the same connection.
+  void release(uint64_t connection_id, const ConnectionInfoPtr &info);
+
+  // Drops the entry of a closed connection regardless of active streams.
+  void remove(uint64_t connection_id);
+
+  size_t size() const { return cache_.size(); }
+  size_t idleEntries() const { return idle_entries_; }
+
+private:
+  struct Entry {
+    ConnectionInfoPtr info;
+    uint32_t active_streams = 0;
+    // Value of releases_ when the last active stream released the entry.
+    uint64_t released_at = 0;
+  };
+
+  // Evicts idle entries released before the last max_idle_entries_ / 2
+  // releases. Since release stamps are distinct, at most half of the bound
+  // survives, which keeps eviction amortized constant time.
+  void evictIdle();
+
+  const size_t max_idle_entries_;
+  std::unordered_map<uint64_t, Entry> cache_;
+  size_t idle_entries_ = 0;
+  uint64_t releases_ = 0;
+};
+
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,206 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/export/exporter.h"
+
+#include <algorithm>
+
+namespace Istio {
+namespace Extension {
+namespace Export {
+
+namespace {
+
+constexpr char kContentType[] = "application/x-istio-records";
+constexpr char kRecordCountHeader[] = "x-istio-record-count";
+
+// Batches are at most a few hundred KB, so a 4 KB window loses little ratio,
+// and keeps deflate state at about 40 KB instead of 256 KB per VM.
+constexpr int kDeflateWindowBits = 12;
+constexpr int kDeflateMemLevel = 5;
+
+void appendVarint(std::string *out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+uint32_t defineCounter(const std::string &name) {
+  uint32_t metric_id = 0;
+  defineMetric(MetricType::Counter, name, &metric_id);
+  return metric_id;
+}
+
+// Whether a collector status means the batch was delivered. Collectors may
+// answer 202 or 204 rather than 200.
+bool isSuccess(StringView status) {
+  return status.size() == 3 && status[0] == '2';
+}
+
+} // namespace
+
+Exporter::Exporter(RootContext *root, ExporterConfig config)
+    : root_(root), config_(std::move(config)),
+      self_(std::make_shared<Exporter *>(this)) {
+  config_.buffer_size = std::max<size_t>(config_.buffer_size, 1);
+  config_.batch_size =
+      std::min(std::max<size_t>(config_.batch_size, 1), config_.buffer_size);
+  config_.sample_rate = std::max<uint32_t>(config_.sample_rate, 1);
+  slots_.resize(config_.buffer_size);
+  sent_metric_ = defineCounter(config_.stat_prefix + "records_sent");
+  dropped_metric_ = defineCounter(config_.stat_prefix + "records_dropped");
+  failed_metric_ = defineCounter(config_.stat_prefix + "records_failed");
+
+  if (config_.compression == Compression::Deflate) {
+    deflate_ = std::make_unique<z_stream>();
+    if (deflateInit2(deflate_.get(), config_.compression_level, Z_DEFLATED,
+                     kDeflateWindowBits, kDeflateMemLevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      LOG_WARN("cannot initialize deflate, sending records uncompressed");
+      deflate_.reset();
+    }
+  }
+}
+
+Exporter::~Exporter() { stopCompressing(); }
+
+void Exporter::stopCompressing() {
+  if (deflate_ != nullptr) {
+    deflateEnd(deflate_.get());
+    deflate_.reset();
+  }
+}
+
+void Exporter::add(StringView record) {
+  if (config_.overflow_policy == OverflowPolicy::Sample &&
+      size_ >= config_.buffer_size * 3 / 4 &&
+      sample_counter_++ % config_.sample_rate != 0) {
+    count(dropped_metric_, &dropped_records_, 1);
+    return;
+  }
+  if (size_ == config_.buffer_size) {
+    dropOldest();
+  }
+  auto &slot = slots_[(head_ + size_) % slots_.size()];
+  slot.assign(record.data(), record.size());
+  size_++;
+
+  if (size_ >= config_.batch_size) {
+    flush();
+  }
+}
+
+void Exporter::dropOldest() {
+  head_ = (head_ + 1) % slots_.size();
+  size_--;
+  count(dropped_metric_, &dropped_records_, 1);
+}
+
+void Exporter::flush() {
+  while (size_ > 0 && in_flight_ < config_.max_in_flight) {
+    size_t records = std::min(size_, config_.batch_size);
+    body_.clear();
+    for (size_t i = 0; i < records; i++) {
+      const auto &slot = slots_[head_];
+      appendVarint(&body_, slot.size());
+      body_.append(slot);
+      head_ = (head_ + 1) % slots_.size();
+    }
+    size_ -= records;
+
+    HeaderStringPairs headers{
+        {":method", "POST"},
+        {":path", config_.path},
+        {":authority", config_.authority},
+        {"content-type", kContentType},
+        {kRecordCountHeader, std::to_string(records)},
+    };
+    bool compressed = deflate_ != nullptr && deflateBody();
+    if (compressed) {
+      headers.emplace_back("content-encoding", "deflate");
+    }
+    std::weak_ptr<Exporter *> self = self_;
+    auto result = root_->httpCall(
+        config_.cluster, headers, compressed ? compressed_ : body_, {},
+        config_.timeout_ms,
+        [self, records, compressed](uint32_t, size_t, uint32_t) {
+          auto exporter = self.lock();
+          if (exporter) {
+            (*exporter)->onResponse(records, compressed);
+          }
+        });
+    if (result != WasmResult::Ok) {
+      LOG_DEBUG("cannot send records to " + config_.cluster + ": " +
+                toString(result));
+      count(failed_metric_, &failed_records_, records);
+      return;
+    }
+    in_flight_++;
+  }
+}
+
+bool Exporter::deflateBody() {
+  auto *stream = deflate_.get();
+  if (deflateReset(stream) != Z_OK) {
+    return false;
+  }
+  // Capacity is kept across batches.
+  compressed_.resize(deflateBound(stream, body_.size()));
+  stream->next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(body_.data()));
+  stream->avail_in = body_.size();
+  stream->next_out = reinterpret_cast<Bytef *>(&compressed_[0]);
+  stream->avail_out = compressed_.size();
+  if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+    return false;
+  }
+  compressed_.resize(stream->total_out);
+  return true;
+}
+
+void Exporter::onResponse(size_t records, bool compressed) {
+  in_flight_--;
+  auto status =
+      getHeaderMapValue(HeaderMapType::HttpCallResponseHeaders, ":status");
+  if (status && isSuccess(status->view())) {
+    count(sent_metric_, &sent_records_, records);
+  } else if (compressed && status && status->view() == "415") {
+    // The collector does not accept compressed batches. The batch is lost
+    // like any failed one, but the following ones are sent uncompressed.
+    LOG_INFO("collector " + config_.cluster +
+             " rejected compressed records, sending them uncompressed");
+    stopCompressing();
+    count(failed_metric_, &failed_records_, records);
+  } else {
+    // The call failed or timed out. Records are not retried, so that a slow
+    // collector cannot hold memory in the VM.
+    count(failed_metric_, &failed_records_, records);
+  }
+  // Send what has been held back by the in flight limit.
+  if (size_ >= config_.batch_size) {
+    flush();
+  }
+}
+
+void Exporter::count(uint32_t metric_id, uint64_t *counter, uint64_t records) {
+  *counter += records;
+  incrementMetric(metric_id, records);
+}
+
+} // namespace Export
+} // namespace Extension
+} // namespace Istio
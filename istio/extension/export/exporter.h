@@ -0,0 +1,144 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "proxy_wasm_intrinsics.h"
+#include "zlib.h"
+
+namespace Istio {
+namespace Extension {
+namespace Export {
+
+// What to do with new records when the exporter cannot keep up.
+enum class OverflowPolicy {
+  // Overwrite the oldest buffered record.
+  DropOldest,
+  // Once the buffer is above its high watermark, admit only one of every
+  // sample_rate records. The oldest record is still dropped if it fills up.
+  Sample,
+};
+
+enum class Compression {
+  None,
+  // zlib wrapped deflate, i.e. content-encoding: deflate.
+  Deflate,
+};
+
+struct ExporterConfig {
+  // Upstream cluster of the collector.
+  std::string cluster;
+  std::string authority;
+  std::string path = "/v1/records";
+
+  // Number of records the ring buffer holds.
+  size_t buffer_size = 1024;
+  // Number of buffered records which triggers a flush before the next tick,
+  // and maximum number of records per batch.
+  size_t batch_size = 256;
+  // Maximum number of batches sent and not yet answered.
+  uint32_t max_in_flight = 2;
+  uint32_t timeout_ms = 5000;
+
+  OverflowPolicy overflow_policy = OverflowPolicy::DropOldest;
+  uint32_t sample_rate = 4;
+
+  // Compression of batches. A collector which answers a compressed batch
+  // with 415 gets uncompressed batches from then on.
+  Compression compression = Compression::Deflate;
+  // Deflate level, from 1 (fastest) to 9 (smallest).
+  int compression_level = 1;
+
+  // Prefix of exporter stats, e.g. wasm_exporter_records_sent.
+  std::string stat_prefix = "wasm_exporter_";
+};
+
+// Exporter ships opaque per-request records to a collector in batches. It is
+// owned by a root context: streams add records, which only copy them into a
+// fixed size ring buffer, and the root context calls onTick to flush. A flush
+// also starts as soon as batch_size records are buffered.
+//
+// A batch is sent as one HTTP POST, whose body is the records of the batch,
+// each prefixed with its varint encoded length, deflated unless compression
+// is disabled. Dictionary encoded records, e.g. from AccessLog::RecordEncoder,
+// still repeat ids and timestamps across records, which deflate removes.
+class Exporter {
+public:
+  Exporter(RootContext *root, ExporterConfig config);
+  ~Exporter();
+
+  Exporter(const Exporter &) = delete;
+  Exporter &operator=(const Exporter &) = delete;
+
+  // Buffers a record.
+  void add(StringView record);
+
+  // Sends buffered records. Should be called from root context onTick.
+  void onTick() { flush(); }
+
+  size_t buffered() const { return size_; }
+  uint64_t sentRecords() const { return sent_records_; }
+  uint64_t droppedRecords() const { return dropped_records_; }
+  uint64_t failedRecords() const { return failed_records_; }
+  uint32_t inFlight() const { return in_flight_; }
+  bool compressing() const { return deflate_ != nullptr; }
+
+private:
+  // Sends batches until the buffer is empty or in flight limit is reached.
+  void flush();
+  // Deflates body_ into compressed_. Returns false if that fails, in which
+  // case the batch is sent uncompressed.
+  bool deflateBody();
+  void stopCompressing();
+  void onResponse(size_t records, bool compressed);
+  void dropOldest();
+  void count(uint32_t metric_id, uint64_t *counter, uint64_t records);
+
+  RootContext *root_;
+  ExporterConfig config_;
+
+  // Ring buffer of records. Slots keep their capacity across reuse.
+  std::vector<std::string> slots_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+
+  uint32_t in_flight_ = 0;
+  uint64_t sample_counter_ = 0;
+
+  // Reused request body, and its compressed form.
+  std::string body_;
+  std::string compressed_;
+  // Deflate state, kept across batches so that they do not allocate it.
+  std::unique_ptr<z_stream> deflate_;
+
+  // Shared with the callbacks of calls in flight, which can outlive the
+  // exporter, e.g. when its root context replaces it on reconfiguration.
+  std::shared_ptr<Exporter *> self_;
+
+  uint64_t sent_records_ = 0;
+  uint64_t dropped_records_ = 0;
+  uint64_t failed_records_ = 0;
+  uint32_t sent_metric_ = 0;
+  uint32_t dropped_metric_ = 0;
+  uint32_t failed_metric_ = 0;
+};
+
+} // namespace Export
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,211 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/export/exporter.h"
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace Export {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswers;
+
+std::string header(const FakeHost::HttpCall &call, const std::string &key) {
+  for (const auto &pair : call.headers) {
+    if (pair.first == key) {
+      return pair.second;
+    }
+  }
+  return "";
+}
+
+std::string inflateBody(const std::string &body) {
+  z_stream stream{};
+  EXPECT_EQ(Z_OK, inflateInit(&stream));
+  std::string out(64 * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+  stream.avail_in = body.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = out.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  return out;
+}
+
+// Splits a batch into records, which are prefixed with a one byte length in
+// these tests.
+std::vector<std::string> readRecords(const std::string &body) {
+  std::vector<std::string> records;
+  for (size_t offset = 0; offset < body.size();) {
+    size_t size = static_cast<uint8_t>(body[offset]);
+    records.push_back(body.substr(offset + 1, size));
+    offset += size + 1;
+  }
+  return records;
+}
+
+class ExporterTest : public testing::Test {
+protected:
+  void SetUp() override {
+    FakeHost::get().reset();
+    FakeHost::get().acceptHttpCalls(true);
+    FakeHost::get().setRootAnswers(&answers_);
+    config_.cluster = "collector";
+    config_.authority = "collector";
+    config_.batch_size = 2;
+  }
+
+  void TearDown() override {
+    FakeHost::get().setRootAnswers(nullptr);
+    FakeHost::get().reset();
+  }
+
+  // Answers the call with the given token with status.
+  void respond(uint32_t token, const std::string &status) {
+    std::string key(1,
+                    static_cast<char>(HeaderMapType::HttpCallResponseHeaders));
+    answers_[key + ":status"] = {true, status};
+    root_.onHttpCallResponse(token, 1, 0, 0);
+  }
+
+  const std::vector<FakeHost::HttpCall> &calls() {
+    return FakeHost::get().httpCalls();
+  }
+
+  HostAnswers answers_;
+  RootContext root_{1, ""};
+  ExporterConfig config_;
+};
+
+TEST_F(ExporterTest, SendsDeflatedBatches) {
+  Exporter exporter(&root_, config_);
+  ASSERT_TRUE(exporter.compressing());
+  exporter.add("first record");
+  EXPECT_TRUE(calls().empty());
+  exporter.add("second record");
+
+  ASSERT_EQ(1, calls().size());
+  const auto &call = calls()[0];
+  EXPECT_EQ("collector", call.cluster);
+  EXPECT_EQ("POST", header(call, ":method"));
+  EXPECT_EQ("/v1/records", header(call, ":path"));
+  EXPECT_EQ("deflate", header(call, "content-encoding"));
+  EXPECT_EQ("2", header(call, "x-istio-record-count"));
+  EXPECT_EQ(std::vector<std::string>({"first record", "second record"}),
+            readRecords(inflateBody(call.body)));
+  EXPECT_EQ(1, exporter.inFlight());
+  EXPECT_EQ(0, exporter.buffered());
+
+  respond(call.token, "200");
+  EXPECT_EQ(0, exporter.inFlight());
+  EXPECT_EQ(2, exporter.sentRecords());
+  EXPECT_EQ(2, FakeHost::get().metric("wasm_exporter_records_sent")->value);
+}
+
+TEST_F(ExporterTest, CountsAnySuccessStatusAsSent) {
+  Exporter exporter(&root_, config_);
+  for (const auto *status : {"202", "204", "299"}) {
+    exporter.add("first");
+    exporter.add("second");
+    respond(calls().back().token, status);
+  }
+  EXPECT_EQ(6, exporter.sentRecords());
+  EXPECT_EQ(0, exporter.failedRecords());
+
+  exporter.add("first");
+  exporter.add("second");
+  respond(calls().back().token, "2000");
+  EXPECT_EQ(2, exporter.failedRecords());
+}
+
+TEST_F(ExporterTest, CompressesRepetitiveRecords) {
+  config_.batch_size = 100;
+  Exporter exporter(&root_, config_);
+  for (int i = 0; i < 100; i++) {
+    exporter.add("reviews.default.svc.cluster.local 200 " + std::to_string(i));
+  }
+  ASSERT_EQ(1, calls().size());
+  auto body = inflateBody(calls()[0].body);
+  EXPECT_EQ(100, readRecords(body).size());
+  EXPECT_LT(calls()[0].body.size() * 4, body.size());
+}
+
+TEST_F(ExporterTest, SendsUncompressedIfDisabled) {
+  config_.compression = Compression::None;
+  Exporter exporter(&root_, config_);
+  EXPECT_FALSE(exporter.compressing());
+  exporter.add("first");
+  exporter.add("second");
+  ASSERT_EQ(1, calls().size());
+  EXPECT_EQ("", header(calls()[0], "content-encoding"));
+  EXPECT_EQ(std::vector<std::string>({"first", "second"}),
+            readRecords(calls()[0].body));
+}
+
+TEST_F(ExporterTest, StopsCompressingIfRejected) {
+  Exporter exporter(&root_, config_);
+  exporter.add("first");
+  exporter.add("second");
+  ASSERT_EQ(1, calls().size());
+  respond(calls()[0].token, "415");
+  EXPECT_FALSE(exporter.compressing());
+  EXPECT_EQ(2, exporter.failedRecords());
+
+  exporter.add("third");
+  exporter.add("fourth");
+  ASSERT_EQ(2, calls().size());
+  EXPECT_EQ("", header(calls()[1], "content-encoding"));
+  EXPECT_EQ(std::vector<std::string>({"third", "fourth"}),
+            readRecords(calls()[1].body));
+  // An uncompressed batch rejected with 415 is a plain failure.
+  respond(calls()[1].token, "415");
+  EXPECT_EQ(4, exporter.failedRecords());
+}
+
+TEST_F(ExporterTest, LimitsBatchesInFlight) {
+  config_.max_in_flight = 1;
+  Exporter exporter(&root_, config_);
+  for (int i = 0; i < 4; i++) {
+    exporter.add("record");
+  }
+  ASSERT_EQ(1, calls().size());
+  EXPECT_EQ(2, exporter.buffered());
+
+  respond(calls()[0].token, "503");
+  EXPECT_EQ(2, exporter.failedRecords());
+  // The held back batch goes out once the first is answered.
+  ASSERT_EQ(2, calls().size());
+  EXPECT_EQ(0, exporter.buffered());
+}
+
+TEST_F(ExporterTest, IgnoresResponsesAfterDestruction) {
+  auto exporter = std::make_unique<Exporter>(&root_, config_);
+  exporter->add("first");
+  exporter->add("second");
+  ASSERT_EQ(1, calls().size());
+  exporter.reset();
+  respond(calls()[0].token, "200");
+  EXPECT_EQ(0, FakeHost::get().metric("wasm_exporter_records_sent")->value);
+}
+
+} // namespace
+} // namespace Export
+} // namespace Extension
+} // namespace Istio
@@ -15,18 +15,15 @@
 
 #include "istio/extension/extension.h"
 
-#include "absl/strings/str_split.h"
+#include "istio/extension/util/host_trace.h"
 
 namespace Istio {
 namespace Extension {
 
-const std::set<std::string> kGrpcContentTypes{
+constexpr StringView kGrpcContentTypes[] = {
     "application/grpc", "application/grpc+proto", "application/grpc+json"};
 
-// Header keys
-constexpr StringView AuthorityHeaderKey = ":authority";
-constexpr StringView ContentTypeHeaderKey = "content-type";
-
+const std::string kEmptyString;
 const std::string kProtocolHTTP = "http";
 const std::string kProtocolGRPC = "grpc";
 
@@ -37,27 +34,50 @@ const char kPassThroughRouteName[] = "allow_any";
 const char kInboundPassthroughClusterIpv4[] = "InboundPassthroughClusterIpv4";
 const char kInboundPassthroughClusterIpv6[] = "InboundPassthroughClusterIpv6";
 
+const char kNodeInfoSnapshotKeyPrefix[] = "istio.node_info_cache_snapshot.";
+// Node info cache snapshots are refreshed on tick at most this often.
+constexpr uint64_t kNodeInfoSnapshotIntervalSeconds = 10;
+// Tick period set on configure, which drives cache sweeps, snapshots and
+// adaptive sampling.
+constexpr uint32_t kTickPeriodMilliseconds = 1000;
+
 namespace {
 
+// Strips the port from an address, e.g. 10.0.0.1:80 or [::1]:80.
+StringView stripPort(StringView address) {
+  if (!address.empty() && address[0] == '[') {
+    auto end = address.find(']');
+    return end == StringView::npos ? address : address.substr(1, end - 1);
+  }
+  auto pos = address.rfind(':');
+  return pos == StringView::npos ? address : address.substr(0, pos);
+}
+
+bool isGrpcContentType(StringView content_type) {
+  for (const auto &grpc_content_type : kGrpcContentTypes) {
+    if (content_type == grpc_content_type) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Extract service name from service host.
-void extractServiceName(const std::string &host,
-                        const std::string &destination_namespace,
-                        std::string *service_name) {
+StringView extractServiceName(StringView host,
+                              StringView destination_namespace) {
   auto name_pos = host.find_first_of(".:");
-  if (name_pos == std::string::npos) {
+  if (name_pos == StringView::npos) {
     // host is already a short service name. return it directly.
-    *service_name = host;
-    return;
+    return host;
   }
   if (host[name_pos] == ':') {
     // host is `short_service:port`, return short_service name.
-    *service_name = host.substr(0, name_pos);
-    return;
+    return host.substr(0, name_pos);
   }
 
   auto namespace_pos = host.find_first_of(".:", name_pos + 1);
-  std::string service_namespace = "";
-  if (namespace_pos == std::string::npos) {
+  StringView service_namespace;
+  if (namespace_pos == StringView::npos) {
     service_namespace = host.substr(name_pos + 1);
   } else {
     int namespace_size = namespace_pos - name_pos - 1;
@@ -67,179 +87,549 @@ void extractServiceName(const std::string &host,
   // If it is the same, return the first part of host as service name.
   // Otherwise fallback to request host.
   if (service_namespace == destination_namespace) {
-    *service_name = host.substr(0, name_pos);
-  } else {
-    *service_name = host;
+    return host.substr(0, name_pos);
   }
+  return host;
 }
 
-// Get destination service host and name based on destination cluster name and
-// host header.
-// * If cluster name is one of passthrough and blackhole clusters, use cluster
-//   name as destination service name and host header as destination host.
-// * If cluster name follows Istio convention (four parts separated by pipe),
-//   use the last part as destination host; Otherwise, use host header as
-//   destination host. To get destination service name from host: if destination
-//   host is already a short name, use that as destination service; otherwise if
-//   the second part of destination host is destination namespace, use first
-//   part as destination service name. Otherwise, fallback to use destination
-//   host for destination service name.
-void getDestinationService(const std::string &dest_namespace,
-                           std::string *dest_svc_host,
-                           std::string *dest_svc_name) {
-  std::string cluster_name;
-  getValue({"cluster_name"}, &cluster_name);
-  *dest_svc_host =
-      getHeaderMapValue(HeaderMapType::RequestHeaders, AuthorityHeaderKey)
-          ->toString();
-
-  // override the cluster name if this is being sent to the
-  // blackhole or passthrough cluster
-  std::string route_name;
-  getValue({"route_name"}, &route_name);
-  if (route_name == kBlackHoleRouteName) {
-    cluster_name = kBlackHoleCluster;
-  } else if (route_name == kPassThroughRouteName) {
-    cluster_name = kPassThroughCluster;
+// Gets the last part of a cluster name which follows Istio convention, i.e.
+// four parts separated by pipe.
+bool getClusterServiceHost(StringView cluster_name, StringView *host) {
+  size_t pos = 0;
+  for (int i = 0; i < 3; i++) {
+    pos = cluster_name.find('|', pos);
+    if (pos == StringView::npos) {
+      return false;
+    }
+    pos++;
+  }
+  if (cluster_name.find('|', pos) != StringView::npos) {
+    return false;
   }
+  *host = cluster_name.substr(pos);
+  return true;
+}
 
-  if (cluster_name == kBlackHoleCluster ||
-      cluster_name == kPassThroughCluster ||
-      cluster_name == kInboundPassthroughClusterIpv4 ||
-      cluster_name == kInboundPassthroughClusterIpv6) {
-    *dest_svc_name = cluster_name;
-    return;
+} // namespace
+
+bool ExtensionRootContext::onConfigure(size_t) {
+  proxy_set_tick_period_milliseconds(kTickPeriodMilliseconds);
+  auto restored = node_info_->restoreSnapshot(nodeInfoSnapshotKey(),
+                                              nodeInfoSnapshotVersion());
+  if (restored > 0) {
+    LOG_DEBUG("restored " + std::to_string(restored) +
+              " node info cache entries");
   }
+  return true;
+}
 
-  std::vector<absl::string_view> parts = absl::StrSplit(cluster_name, '|');
-  if (parts.size() == 4) {
-    *dest_svc_host = std::string(parts[3].data(), parts[3].size());
+void ExtensionRootContext::onTick() {
+  sampler_.onTick();
+  node_info_->sweepCache();
+  peer_resolver_.onTick();
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  Util::flushHostTrace();
+#endif
+  uint64_t now = getCurrentTimeNanoseconds();
+  if (now - last_node_info_snapshot_ns_ >=
+      kNodeInfoSnapshotIntervalSeconds * 1000000000ull) {
+    node_info_->saveSnapshot(nodeInfoSnapshotKey(), nodeInfoSnapshotVersion());
+    last_node_info_snapshot_ns_ = now;
   }
+}
 
-  extractServiceName(*dest_svc_host, dest_namespace, dest_svc_name);
+bool ExtensionRootContext::onDone() {
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  Util::flushHostTrace();
+#endif
+  node_info_->saveSnapshot(nodeInfoSnapshotKey(), nodeInfoSnapshotVersion());
+  return true;
 }
 
-} // namespace
+std::string ExtensionRootContext::nodeInfoSnapshotKey() {
+  auto id = root_id();
+  return std::string(kNodeInfoSnapshotKeyPrefix).append(id.data(), id.size());
+}
+
+const std::string &ExtensionRootContext::nodeInfoSnapshotVersion() {
+  return getLocalNodeInfo().istio_version();
+}
 
 const istio::extension::NodeInfo &
 ExtensionRootContext::getPeerNodeInfo(bool is_outbound) {
   return node_info_->getPeerNodeInfo(is_outbound);
 }
 
+NodeInfo::NodeInfoPtr
+ExtensionRootContext::getPeerNodeInfoPtr(bool is_outbound) {
+  return node_info_->getPeerNodeInfoPtr(is_outbound);
+}
+
 const istio::extension::NodeInfo &ExtensionRootContext::getLocalNodeInfo() {
   return node_info_->getLocalNodeInfo();
 }
 
+ExtensionStreamContext::~ExtensionStreamContext() {
+  HOST_TRACE_STREAM_END(id());
+  getRootContext()->attributePrefetch().record(attributes_.hostCalls(),
+                                               attributes_.callsSaved());
+  if (awaiting_peer_) {
+    getRootContext()->peerResolver().cancel(peer_address_, this);
+  }
+  if (connection_info_shared_) {
+    getRootContext()->releaseConnectionInfo(connection_id_,
+                                           connection_info_);
+  }
+}
+
+bool ExtensionStreamContext::sampled() {
+  HOST_TRACE_SCOPE(id());
+  if (sampling_decision_ == SamplingDecision::Undecided) {
+    auto &sampler = getRootContext()->sampler();
+    bool sampled = true;
+    if (!sampler.sampleAll()) {
+      // Only x-request-id is fetched, as an unsampled request should not pay
+      // for a header snapshot.
+      auto request_id =
+          Util::readHeaderValue(HeaderMapType::RequestHeaders,
+                                "x-request-id");
+      sampled = request_id && !request_id->view().empty()
+                    ? sampler.sample(request_id->view())
+                    : sampler.sample(static_cast<uint64_t>(id()));
+    }
+    sampling_decision_ = sampled ? SamplingDecision::Sampled
+                                 : SamplingDecision::NotSampled;
+  }
+  return sampling_decision_ == SamplingDecision::Sampled;
+}
+
+bool ExtensionStreamContext::awaitPeerNodeInfo() {
+  HOST_TRACE_SCOPE(id());
+  auto &resolver = getRootContext()->peerResolver();
+  if (!resolver.enabled() || !sampled() || isOutbound() ||
+      &downstreamPeerNodeInfo() != &NodeInfo::EmptyNodeInfo) {
+    return true;
+  }
+  std::string source_address;
+  if (!Util::readValue({"source", "address"}, &source_address)) {
+    return true;
+  }
+  auto address = stripPort(source_address);
+  peer_address_.assign(address.data(), address.size());
+  awaiting_peer_ = !resolver.resolve(peer_address_, id(), this);
+  return !awaiting_peer_;
+}
+
+void ExtensionStreamContext::onPeerResolved(NodeInfo::NodeInfoPtr node_info) {
+  HOST_TRACE_SCOPE(id());
+  awaiting_peer_ = false;
+  // Streams on the same connection share the peer.
+  if (node_info) {
+    connectionInfo().peer_node_info = std::move(node_info);
+  }
+  continueRequest();
+}
+
 /************************
     Node Property
 ************************/
 
-#define NODE_ATTRIBUTE_FUNC(_p, an, _fn)                                       \
-  const std::string &ExtensionStreamContext::_p##_fn() {                       \
+#define NODE_ATTRIBUTE_FUNC(_c, _p, an, _fn)                                   \
+  const std::string &_c::_p##_fn() {                                           \
     auto &node = _p##NodeInfo();                                               \
     return node.an();                                                          \
   }
 
-NODE_ATTRIBUTE_FUNC(source, name, Name)
-NODE_ATTRIBUTE_FUNC(source, namespace_, Namespace)
-NODE_ATTRIBUTE_FUNC(source, namespace_, Owner)
-NODE_ATTRIBUTE_FUNC(source, workload_name, WorkloadName)
-NODE_ATTRIBUTE_FUNC(source, istio_version, IstioVersion)
-NODE_ATTRIBUTE_FUNC(source, mesh_id, MeshID)
-
-NODE_ATTRIBUTE_FUNC(destination, name, Name)
-NODE_ATTRIBUTE_FUNC(destination, namespace_, Namespace)
-NODE_ATTRIBUTE_FUNC(destination, namespace_, Owner)
-NODE_ATTRIBUTE_FUNC(destination, workload_name, WorkloadName)
-NODE_ATTRIBUTE_FUNC(destination, istio_version, IstioVersion)
-NODE_ATTRIBUTE_FUNC(destination, mesh_id, MeshID)
+#define NODE_ATTRIBUTE_FUNCS(_c)                                               \
+  NODE_ATTRIBUTE_FUNC(_c, source, name, Name)                                  \
+  NODE_ATTRIBUTE_FUNC(_c, source, namespace_, Namespace)                       \
+  NODE_ATTRIBUTE_FUNC(_c, source, namespace_, Owner)                           \
+  NODE_ATTRIBUTE_FUNC(_c, source, workload_name, WorkloadName)                 \
+  NODE_ATTRIBUTE_FUNC(_c, source, istio_version, IstioVersion)                 \
+  NODE_ATTRIBUTE_FUNC(_c, source, mesh_id, MeshID)                             \
+                                                                               \
+  NODE_ATTRIBUTE_FUNC(_c, destination, name, Name)                             \
+  NODE_ATTRIBUTE_FUNC(_c, destination, namespace_, Namespace)                  \
+  NODE_ATTRIBUTE_FUNC(_c, destination, namespace_, Owner)                      \
+  NODE_ATTRIBUTE_FUNC(_c, destination, workload_name, WorkloadName)            \
+  NODE_ATTRIBUTE_FUNC(_c, destination, istio_version, IstioVersion)            \
+  NODE_ATTRIBUTE_FUNC(_c, destination, mesh_id, MeshID)
+
+NODE_ATTRIBUTE_FUNCS(ExtensionStreamContext)
 
 /************************
     Request Property
 ************************/
 
 // Direction
-bool ExtensionStreamContext::isOutbound() {
-  int64_t direction;
-  getValue({"listener_direction"}, &direction);
-  return static_cast<TrafficDirection>(direction) == TrafficDirection::Outbound;
+TrafficDirection ExtensionStreamContext::direction() {
+  return connectionInfo().direction;
 }
 
 // Connection
 int64_t ExtensionStreamContext::destinationPort() {
-  int64_t destination_port = 0;
-  if (isOutbound()) {
-    getValue({"upstream", "port"}, &destination_port);
-  } else {
-    getValue({"destination", "port"}, &destination_port);
+  HOST_TRACE_SCOPE(id());
+  if (!sampled()) {
+    return 0;
   }
+  if (!isOutbound()) {
+    return connectionInfo().destination_port;
+  }
+  int64_t destination_port = 0;
+  attributes_.get(Attribute::UpstreamPort, &destination_port);
   return destination_port;
 }
 
+// Response code
+int64_t ExtensionStreamContext::responseCode() {
+  HOST_TRACE_SCOPE(id());
+  int64_t response_code = 0;
+  if (!sampled()) {
+    return response_code;
+  }
+  attributes_.get(Attribute::ResponseCode, &response_code);
+  return response_code;
+}
+
+int64_t ExtensionStreamContext::requestTime() {
+  HOST_TRACE_SCOPE(id());
+  int64_t time = 0;
+  if (sampled()) {
+    attributes_.get(Attribute::RequestTime, &time);
+  }
+  return time;
+}
+
+int64_t ExtensionStreamContext::requestDuration() {
+  HOST_TRACE_SCOPE(id());
+  int64_t duration = 0;
+  if (sampled()) {
+    attributes_.get(Attribute::RequestDuration, &duration);
+  }
+  return duration;
+}
+
+int64_t ExtensionStreamContext::requestTotalSize() {
+  HOST_TRACE_SCOPE(id());
+  int64_t size = 0;
+  if (sampled()) {
+    attributes_.get(Attribute::RequestTotalSize, &size);
+  }
+  return size;
+}
+
+int64_t ExtensionStreamContext::responseTotalSize() {
+  HOST_TRACE_SCOPE(id());
+  int64_t size = 0;
+  if (sampled()) {
+    attributes_.get(Attribute::ResponseTotalSize, &size);
+  }
+  return size;
+}
+
 // Response flag
-const std::string ExtensionStreamContext::responseFlag() {
-  uint64_t response_flags_mask = 0;
-  getValue({"response", "flags"}, &response_flags_mask);
-  return Util::parseResponseFlag(response_flags_mask);
+uint64_t ExtensionStreamContext::responseFlags() {
+  HOST_TRACE_SCOPE(id());
+  uint64_t flags = 0;
+  if (sampled()) {
+    attributes_.get(Attribute::ResponseFlags, &flags);
+  }
+  return flags;
+}
+
+StringView ExtensionStreamContext::responseFlag() {
+  HOST_TRACE_SCOPE(id());
+  if (!sampled()) {
+    return {};
+  }
+  return Util::parseResponseFlag(responseFlags(), &response_flag_);
 }
 
 const std::string &ExtensionStreamContext::requestProtocol() {
-  if (kGrpcContentTypes.count(
-          getHeaderMapValue(HeaderMapType::RequestHeaders, ContentTypeHeaderKey)
-              ->toString()) != 0) {
+  if (isGrpcContentType(
+          requestHeaders().get(Util::WellKnownHeader::ContentType))) {
     return kProtocolGRPC;
   }
   return kProtocolHTTP;
 }
 
+// Get destination service host and name based on destination cluster name and
+// host header.
+// * If cluster name is one of passthrough and blackhole clusters, use cluster
+//   name as destination service name and host header as destination host.
+// * If cluster name follows Istio convention (four parts separated by pipe),
+//   use the last part as destination host; Otherwise, use host header as
+//   destination host. To get destination service name from host: if destination
+//   host is already a short name, use that as destination service; otherwise if
+//   the second part of destination host is destination namespace, use first
+//   part as destination service name. Otherwise, fallback to use destination
+//   host for destination service name.
+void ExtensionStreamContext::destinationService(StringView *dest_host,
+                                                StringView *dest_name) {
+  HOST_TRACE_SCOPE(id());
+  *dest_host = StringView();
+  *dest_name = StringView();
+  if (!sampled()) {
+    return;
+  }
+  const auto &destination_namespace = destinationNodeInfo().namespace_();
+  *dest_host = requestHeaders().get(Util::WellKnownHeader::Authority);
+
+  StringView cluster_name;
+  attributes_.get(Attribute::ClusterName, &cluster_name);
+
+  // override the cluster name if this is being sent to the
+  // blackhole or passthrough cluster
+  StringView route_name;
+  attributes_.get(Attribute::RouteName, &route_name);
+  if (route_name == kBlackHoleRouteName) {
+    cluster_name = kBlackHoleCluster;
+  } else if (route_name == kPassThroughRouteName) {
+    cluster_name = kPassThroughCluster;
+  }
+
+  if (cluster_name == kBlackHoleCluster ||
+      cluster_name == kPassThroughCluster ||
+      cluster_name == kInboundPassthroughClusterIpv4 ||
+      cluster_name == kInboundPassthroughClusterIpv6) {
+    *dest_name = cluster_name;
+    return;
+  }
+
+  getClusterServiceHost(cluster_name, dest_host);
+  *dest_name = extractServiceName(*dest_host, destination_namespace);
+}
+
 void ExtensionStreamContext::destinationService(std::string *dest_host,
                                                 std::string *dest_name) {
-  const auto &destination_namespace = destinationNodeInfo().namespace_();
-  getDestinationService(destination_namespace, dest_host, dest_name);
+  StringView host;
+  StringView name;
+  destinationService(&host, &name);
+  dest_host->assign(host.data(), host.size());
+  dest_name->assign(name.data(), name.size());
+}
+
+const Util::HeaderSnapshot &ExtensionStreamContext::requestHeaders() {
+  HOST_TRACE_SCOPE(id());
+  // An unsampled request gets the empty snapshot.
+  if (!request_headers_.loaded() && sampled()) {
+    request_headers_.load(HeaderMapType::RequestHeaders);
+  }
+  return request_headers_;
 }
 
 ServiceAuthenticationPolicy
 ExtensionStreamContext::serviceAuthenticationPolicy() {
-  if (isOutbound()) {
+  if (!sampled() || isOutbound()) {
     return ServiceAuthenticationPolicy::Unspecified;
   }
-  bool mtls = false;
-  getValue({"connection", "mtls"}, &mtls);
-  return mtls ? ServiceAuthenticationPolicy::MutualTLS
-              : ServiceAuthenticationPolicy::None;
+  return connectionInfo().mtls ? ServiceAuthenticationPolicy::MutualTLS
+                               : ServiceAuthenticationPolicy::None;
 }
 
 const std::string& ExtensionStreamContext::sourcePrincipal() {
+  if (!sampled()) {
+    return kEmptyString;
+  }
   if (isOutbound()) {
-    getValue({"upstream", "uri_san_local_certificate"}, &source_principal_);
-  } else {
-    getValue({"connection", "uri_san_peer_certificate"}, &source_principal_);
+    fetchUpstreamPrincipals();
+    return source_principal_;
   }
-  return source_principal_;
+  return connectionInfo().peer_principal;
 }
 
 const std::string& ExtensionStreamContext::destinationPrincipal() {
+  if (!sampled()) {
+    return kEmptyString;
+  }
   if (isOutbound()) {
-    getValue({"upstream", "uri_san_peer_certificate"}, &destination_principal_);
-  } else {
-    getValue({"connection", "uri_san_local_certificate"}, &destination_principal_);
+    fetchUpstreamPrincipals();
+    return destination_principal_;
+  }
+  return connectionInfo().local_principal;
+}
+
+void ExtensionStreamContext::fetchUpstreamPrincipals() {
+  HOST_TRACE_SCOPE(id());
+  if (upstream_principals_fetched_) {
+    return;
+  }
+  // Upstream is not known before the request is routed, in which case the
+  // principals are fetched again on the next call.
+  StringView principal;
+  upstream_principals_fetched_ =
+      attributes_.get(Attribute::UpstreamLocalPrincipal, &principal);
+  source_principal_.assign(principal.data(), principal.size());
+  if (attributes_.get(Attribute::UpstreamPeerPrincipal, &principal)) {
+    destination_principal_.assign(principal.data(), principal.size());
   }
-  return destination_principal_;
 }
 
 const istio::extension::NodeInfo &ExtensionStreamContext::sourceNodeInfo() {
-  auto *root = getRootContext();
-  bool is_outbound = isOutbound();
-  return is_outbound ? root->getLocalNodeInfo()
-                     : root->getPeerNodeInfo(/*is_outbound = */ false);
+  if (!sampled()) {
+    return NodeInfo::EmptyNodeInfo;
+  }
+  return isOutbound() ? getRootContext()->getLocalNodeInfo()
+                      : downstreamPeerNodeInfo();
 }
 
 const istio::extension::NodeInfo &
 ExtensionStreamContext::destinationNodeInfo() {
+  HOST_TRACE_SCOPE(id());
+  if (!sampled()) {
+    return NodeInfo::EmptyNodeInfo;
+  }
   auto *root = getRootContext();
-  bool is_outbound = isOutbound();
-  return is_outbound ? root->getPeerNodeInfo(/*is_outbound = */ true)
-                     : root->getLocalNodeInfo();
+  return isOutbound() ? root->getPeerNodeInfo(/*is_outbound = */ true)
+                      : root->getLocalNodeInfo();
+}
+
+const istio::extension::NodeInfo &
+ExtensionStreamContext::downstreamPeerNodeInfo() {
+  HOST_TRACE_SCOPE(id());
+  auto &connection = connectionInfo();
+  if (!connection.peer_node_info) {
+    connection.peer_node_info =
+        getRootContext()->getPeerNodeInfoPtr(/*is_outbound = */ false);
+  }
+  if (!connection.peer_node_info && !peer_address_.empty()) {
+    connection.peer_node_info =
+        getRootContext()->peerResolver().lookup(peer_address_);
+  }
+  return connection.peer_node_info ? *connection.peer_node_info
+                                   : NodeInfo::EmptyNodeInfo;
+}
+
+ConnectionInfo &ExtensionStreamContext::connectionInfo() {
+  HOST_TRACE_SCOPE(id());
+  if (connection_info_) {
+    return *connection_info_;
+  }
+  if (attributes_.get(Attribute::ConnectionId, &connection_id_)) {
+    connection_info_ =
+        getRootContext()->acquireConnectionInfo(connection_id_, &attributes_);
+    connection_info_shared_ = true;
+  } else {
+    connection_info_ = fetchConnectionInfo(&attributes_);
+  }
+  return *connection_info_;
+}
+
+/************************
+    Network Context
+************************/
+
+namespace {
+
+// Number of peer data callbacks to wait for peer metadata exchange, after
+// which the peer is considered not to support it.
+constexpr uint32_t kMaxPeerResolveAttempts = 3;
+
+} // namespace
+
+FilterStatus ExtensionNetworkContext::onDownstreamData(size_t data_length,
+                                                       bool) {
+  received_bytes_ += data_length;
+  if (!isOutbound()) {
+    resolvePeerNodeInfo();
+  }
+  return FilterStatus::Continue;
+}
+
+FilterStatus ExtensionNetworkContext::onUpstreamData(size_t data_length,
+                                                     bool) {
+  sent_bytes_ += data_length;
+  if (isOutbound()) {
+    resolvePeerNodeInfo();
+  }
+  return FilterStatus::Continue;
+}
+
+void ExtensionNetworkContext::onDownstreamConnectionClose(PeerType) {
+  HOST_TRACE_SCOPE(id());
+  uint64_t connection_id = 0;
+  if (attributes_.get(Attribute::ConnectionId, &connection_id)) {
+    getRootContext()->onConnectionClosed(connection_id);
+  }
+}
+
+NODE_ATTRIBUTE_FUNCS(ExtensionNetworkContext)
+
+bool ExtensionNetworkContext::isOutbound() {
+  return connectionInfo().direction == TrafficDirection::Outbound;
+}
+
+int64_t ExtensionNetworkContext::destinationPort() {
+  return isOutbound() ? upstreamInfo().port
+                      : connectionInfo().destination_port;
+}
+
+ServiceAuthenticationPolicy
+ExtensionNetworkContext::serviceAuthenticationPolicy() {
+  if (isOutbound()) {
+    return ServiceAuthenticationPolicy::Unspecified;
+  }
+  return connectionInfo().mtls ? ServiceAuthenticationPolicy::MutualTLS
+                               : ServiceAuthenticationPolicy::None;
+}
+
+const std::string &ExtensionNetworkContext::sourcePrincipal() {
+  return isOutbound() ? upstreamInfo().local_principal
+                      : connectionInfo().peer_principal;
+}
+
+const std::string &ExtensionNetworkContext::destinationPrincipal() {
+  return isOutbound() ? upstreamInfo().peer_principal
+                      : connectionInfo().local_principal;
+}
+
+const istio::extension::NodeInfo &ExtensionNetworkContext::sourceNodeInfo() {
+  return isOutbound() ? getRootContext()->getLocalNodeInfo() : peerNodeInfo();
+}
+
+const istio::extension::NodeInfo &
+ExtensionNetworkContext::destinationNodeInfo() {
+  return isOutbound() ? peerNodeInfo() : getRootContext()->getLocalNodeInfo();
+}
+
+const istio::extension::NodeInfo &ExtensionNetworkContext::peerNodeInfo() {
+  return peer_node_info_ ? *peer_node_info_ : NodeInfo::EmptyNodeInfo;
+}
+
+void ExtensionNetworkContext::resolvePeerNodeInfo() {
+  HOST_TRACE_SCOPE(id());
+  // Metadata is exchanged in the first bytes from the peer, so attempts are
+  // only spent by data callbacks, never by accessors called before them.
+  if (!peer_node_info_ && peer_resolve_attempts_ < kMaxPeerResolveAttempts) {
+    peer_resolve_attempts_++;
+    peer_node_info_ = getRootContext()->getPeerNodeInfoPtr(isOutbound());
+  }
+}
+
+const ConnectionInfo &ExtensionNetworkContext::connectionInfo() {
+  HOST_TRACE_SCOPE(id());
+  if (!connection_info_) {
+    connection_info_ = fetchConnectionInfo(&attributes_);
+  }
+  return *connection_info_;
+}
+
+const ExtensionNetworkContext::UpstreamInfo &
+ExtensionNetworkContext::upstreamInfo() {
+  HOST_TRACE_SCOPE(id());
+  if (!upstream_info_) {
+    upstream_info_ = std::make_unique<UpstreamInfo>();
+    attributes_.get(Attribute::UpstreamPort, &upstream_info_->port);
+    StringView principal;
+    if (attributes_.get(Attribute::UpstreamPeerPrincipal, &principal)) {
+      upstream_info_->peer_principal.assign(principal.data(), principal.size());
+    }
+    if (attributes_.get(Attribute::UpstreamLocalPrincipal, &principal)) {
+      upstream_info_->local_principal.assign(principal.data(),
+                                             principal.size());
+    }
+  }
+  return *upstream_info_;
 }
 
 } // namespace Extension
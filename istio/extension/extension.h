@@ -15,7 +15,12 @@
 
 #pragma once
 
+#include "istio/extension/attributes.h"
+#include "istio/extension/connection_info.h"
 #include "istio/extension/node_info/node_info.h"
+#include "istio/extension/peer_metadata_resolver.h"
+#include "istio/extension/sampler.h"
+#include "istio/extension/util/header_snapshot.h"
 #include "istio/extension/util/util.h"
 
 namespace Istio {
@@ -24,27 +29,136 @@ namespace Extension {
 class ExtensionRootContext : public RootContext {
 public:
   ExtensionRootContext(uint32_t id, StringView root_id)
-      : RootContext(id, root_id) {
-    node_info_ = std::make_unique<NodeInfo::NodeInfo>();
-  }
+      : RootContext(id, root_id),
+        node_info_(std::make_unique<NodeInfo::NodeInfo>()),
+        peer_resolver_(this, node_info_.get()) {}
   ~ExtensionRootContext() = default;
 
+  // Sets a tick period of one second and restores node info cache snapshot
+  // left by a previous VM of this plugin. Subclasses overriding onConfigure
+  // must call the base implementation, and may set another tick period after
+  // it.
+  bool onConfigure(size_t) override;
+
+  // Adjusts adaptive sampling rate, sweeps and periodically snapshots node
+  // info cache, and drops expired peer metadata service failures. Subclasses
+  // overriding onTick must call the base implementation.
+  void onTick() override;
+
+  // Snapshots node info cache for the next VM of this plugin. Subclasses
+  // overriding onDone must call the base implementation.
+  bool onDone() override;
+
   // Gets peer node info. It checks the node info cache first, and then try to
   // fetch it from host if cache miss. If cache is disabled, it will fetch from
   // host directly.
   const istio::extension::NodeInfo &getPeerNodeInfo(bool is_outbound);
 
+  // Same as getPeerNodeInfo, but returns a shared pointer which is empty if
+  // peer metadata is not available.
+  NodeInfo::NodeInfoPtr getPeerNodeInfoPtr(bool is_outbound);
+
+  // Configures peer node info cache. Expired entries are evicted on tick.
+  void configureNodeInfoCache(int32_t max_size, uint64_t ttl_seconds) {
+    node_info_->configureCache(max_size, ttl_seconds);
+  }
+
+  // Resolves node info of downstream peers without metadata exchange from a
+  // metadata service, which is disabled by default. See
+  // ExtensionStreamContext::awaitPeerNodeInfo.
+  void configurePeerMetadataService(PeerMetadataServiceConfig config) {
+    peer_resolver_.configure(std::move(config));
+  }
+  PeerMetadataResolver &peerResolver() { return peer_resolver_; }
+
   // Get Local node information.
   const istio::extension::NodeInfo &getLocalNodeInfo();
 
+  // Gets attributes of the downstream connection with the given id. Streams
+  // on one connection share a single entry, which is fetched from host by the
+  // first of them. Each call must be paired with a release of the returned
+  // info.
+  ConnectionInfoPtr acquireConnectionInfo(uint64_t connection_id,
+                                          Attributes *attributes) {
+    return connection_info_cache_.acquire(connection_id, attributes);
+  }
+  void releaseConnectionInfo(uint64_t connection_id,
+                             const ConnectionInfoPtr &info) {
+    connection_info_cache_.release(connection_id, info);
+  }
+
+  // Drops cached attributes of a closed downstream connection.
+  void onConnectionClosed(uint64_t connection_id) {
+    connection_info_cache_.remove(connection_id);
+  }
+
+  // Request sampling, which is disabled by default. Adaptive sampling adjusts
+  // the rate on tick.
+  void configureSampling(const SamplerConfig &config) {
+    sampler_.configure(config);
+  }
+  Sampler &sampler() { return sampler_; }
+
+  // Declares the attributes the plugin reads, so that those sharing a parent
+  // are fetched by one host call when the first of them is accessed. All
+  // attributes are declared by default. Undeclared attributes are still
+  // read on access, one host call each.
+  void declareAttributes(AttributeSet attributes) {
+    attribute_prefetch_.declare(attributes);
+  }
+  AttributePrefetch &attributePrefetch() { return attribute_prefetch_; }
+
 private:
+  // Shared data key and version of node info cache snapshots. Snapshots are
+  // per root id, and are dropped by proxies of another Istio version.
+  std::string nodeInfoSnapshotKey();
+  const std::string &nodeInfoSnapshotVersion();
+
   std::unique_ptr<NodeInfo::NodeInfo> node_info_;
+  uint64_t last_node_info_snapshot_ns_ = 0;
+  PeerMetadataResolver peer_resolver_;
+  Sampler sampler_;
+  AttributePrefetch attribute_prefetch_;
+
+  ConnectionInfoCache connection_info_cache_;
 };
 
-class ExtensionStreamContext : public Context {
+class ExtensionStreamContext : public Context, public PeerMetadataWaiter {
 public:
-  ExtensionStreamContext(uint32_t id, RootContext *root) : Context(id, root){};
-  ~ExtensionStreamContext() = default;
+  ExtensionStreamContext(uint32_t id, RootContext *root)
+      : Context(id, root),
+        attributes_(&getRootContext()->attributePrefetch()){};
+  ~ExtensionStreamContext();
+
+  // Whether telemetry is collected for this request. The decision is made on
+  // first call from the request id, so it should be made from
+  // onRequestHeaders. Unless every request is sampled, the first call reads
+  // x-request-id from host.
+  //
+  // For an unsampled request, these return without calling host:
+  // - node accessors, e.g. sourceName() and destinationNodeInfo(), which
+  //   return empty values,
+  // - destinationPort(), responseCode(), responseFlags(), responseFlag(),
+  //   requestTime(), requestDuration(), requestTotalSize() and
+  //   responseTotalSize(), which return zero or empty values,
+  // - serviceAuthenticationPolicy(), which returns Unspecified,
+  // - sourcePrincipal(), destinationPrincipal(), destinationService() and
+  //   requestHeaders(), which return empty values,
+  // - requestProtocol(), which returns http as headers are not read,
+  // - awaitPeerNodeInfo(), which returns true without resolving the peer.
+  // direction() and isOutbound() read connection info from host either way.
+  bool sampled();
+
+  // Resolves downstream peer node info from the peer metadata service if it
+  // is configured and the peer did not exchange metadata. Returns false if
+  // the stream should stop iteration until the peer is resolved, after which
+  // it is continued. Should be called from onRequestHeaders of inbound
+  // streams; node info of outbound peers is not resolved, since the upstream
+  // address is not known yet.
+  bool awaitPeerNodeInfo();
+
+  // Takes node info resolved for awaitPeerNodeInfo and continues the request.
+  void onPeerResolved(NodeInfo::NodeInfoPtr node_info) override;
 
   /************************
         Node Property
@@ -64,30 +178,171 @@ public:
   const std::string &destinationIstioVersion();
   const std::string &destinationMeshID();
 
+  // Node info of source and destination. EmptyNodeInfo is returned if the
+  // peer metadata is not available.
+  const istio::extension::NodeInfo &sourceNodeInfo();
+  const istio::extension::NodeInfo &destinationNodeInfo();
+
   /************************
       Request Property
   ************************/
-  bool isOutbound();
+  // Direction is known for unsampled requests too, as it comes from
+  // connection info, which is fetched once per connection.
+  TrafficDirection direction();
+  bool isOutbound() { return direction() == TrafficDirection::Outbound; }
   int64_t destinationPort();
-  const std::string responseFlag();
+  int64_t responseCode();
+  // Response flags as a bitmask of Envoy response flags.
+  uint64_t responseFlags();
+  // Response flags as a short string, "-" if there are none, or empty for an
+  // unsampled request. The returned view is valid until the next call.
+  StringView responseFlag();
   const std::string &requestProtocol();
   ServiceAuthenticationPolicy serviceAuthenticationPolicy();
   const std::string& sourcePrincipal();
   const std::string& destinationPrincipal();
 
+  // Request start time in nanoseconds since epoch.
+  int64_t requestTime();
+  // Request duration in nanoseconds, and request and response sizes
+  // including headers. They are final at onLog.
+  int64_t requestDuration();
+  int64_t requestTotalSize();
+  int64_t responseTotalSize();
+
+  // Destination service host and name. Returned views point into data owned
+  // by this stream, and are valid until the next call.
+  void destinationService(StringView *dest_host, StringView *dest_name);
   void destinationService(std::string *dest_host, std::string *dest_name);
 
+  // Snapshot of request headers. The whole header map is fetched from host
+  // with a single call on first access, and returned values are views into
+  // the host buffer owned by this stream.
+  const Util::HeaderSnapshot &requestHeaders();
+
+  // Host attributes read by this stream, which also count host calls made
+  // and saved by batching.
+  const Attributes &attributes() const { return attributes_; }
+
 private:
   ExtensionRootContext *getRootContext() {
     auto *root = this->root();
     return dynamic_cast<ExtensionRootContext *>(root);
   }
 
-  const istio::extension::NodeInfo &sourceNodeInfo();
-  const istio::extension::NodeInfo &destinationNodeInfo();
+  // Node info of the downstream peer, shared by streams on the connection.
+  const istio::extension::NodeInfo &downstreamPeerNodeInfo();
+
+  // Attributes of the downstream connection. They are fetched once per
+  // connection if host exposes connection id, otherwise once per stream.
+  ConnectionInfo &connectionInfo();
+
+  enum class SamplingDecision : uint8_t { Undecided, Sampled, NotSampled };
+  SamplingDecision sampling_decision_ = SamplingDecision::Undecided;
+
+  Attributes attributes_;
+
+  ConnectionInfoPtr connection_info_;
+  uint64_t connection_id_ = 0;
+  bool connection_info_shared_ = false;
 
+  // Downstream peer address without port, set if node info is resolved by
+  // the peer metadata service.
+  std::string peer_address_;
+  bool awaiting_peer_ = false;
+
+  // Principals of the upstream connection, fetched once per outbound stream.
+  void fetchUpstreamPrincipals();
+  bool upstream_principals_fetched_ = false;
   std::string source_principal_;
   std::string destination_principal_;
+
+  std::string response_flag_;
+
+  Util::HeaderSnapshot request_headers_;
+};
+
+// ExtensionNetworkContext provides node and TLS attributes to network (TCP)
+// filters. Connection attributes are resolved from host once, and peer node
+// info is resolved once peer metadata is exchanged on the first data from the
+// peer. Data callbacks only update byte counters afterwards. Subclasses
+// overriding connection callbacks must call the base implementation.
+class ExtensionNetworkContext : public Context {
+public:
+  ExtensionNetworkContext(uint32_t id, RootContext *root)
+      : Context(id, root),
+        attributes_(&getRootContext()->attributePrefetch()){};
+  ~ExtensionNetworkContext() = default;
+
+  FilterStatus onDownstreamData(size_t data_length,
+                                bool end_of_stream) override;
+  FilterStatus onUpstreamData(size_t data_length, bool end_of_stream) override;
+  void onDownstreamConnectionClose(PeerType peer_type) override;
+
+  /************************
+        Node Property
+  ************************/
+  const std::string &sourceName();
+  const std::string &sourceNamespace();
+  const std::string &sourceOwner();
+  const std::string &sourceWorkloadName();
+  const std::string &sourceIstioVersion();
+  const std::string &sourceMeshID();
+
+  const std::string &destinationName();
+  const std::string &destinationNamespace();
+  const std::string &destinationOwner();
+  const std::string &destinationWorkloadName();
+  const std::string &destinationIstioVersion();
+  const std::string &destinationMeshID();
+
+  /************************
+    Connection Property
+  ************************/
+  bool isOutbound();
+  int64_t destinationPort();
+  ServiceAuthenticationPolicy serviceAuthenticationPolicy();
+  const std::string &sourcePrincipal();
+  const std::string &destinationPrincipal();
+
+  // Bytes received from downstream and upstream so far.
+  uint64_t receivedBytes() const { return received_bytes_; }
+  uint64_t sentBytes() const { return sent_bytes_; }
+
+  // Whether peer node info has been resolved.
+  bool peerResolved() const { return peer_node_info_ != nullptr; }
+
+private:
+  // Upstream attributes of an outbound connection.
+  struct UpstreamInfo {
+    int64_t port = 0;
+    std::string peer_principal;
+    std::string local_principal;
+  };
+
+  ExtensionRootContext *getRootContext() {
+    auto *root = this->root();
+    return dynamic_cast<ExtensionRootContext *>(root);
+  }
+
+  const istio::extension::NodeInfo &sourceNodeInfo();
+  const istio::extension::NodeInfo &destinationNodeInfo();
+  // Peer node info, or EmptyNodeInfo until it is resolved.
+  const istio::extension::NodeInfo &peerNodeInfo();
+  // Tries to resolve peer node info on data from the peer.
+  void resolvePeerNodeInfo();
+
+  const ConnectionInfo &connectionInfo();
+  const UpstreamInfo &upstreamInfo();
+
+  Attributes attributes_;
+  ConnectionInfoPtr connection_info_;
+  std::unique_ptr<UpstreamInfo> upstream_info_;
+  NodeInfo::NodeInfoPtr peer_node_info_;
+  uint32_t peer_resolve_attempts_ = 0;
+
+  uint64_t received_bytes_ = 0;
+  uint64_t sent_bytes_ = 0;
 };
 
 } // namespace Extension
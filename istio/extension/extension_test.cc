@@ -0,0 +1,74 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/extension.h"
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace {
+
+using Replay::FakeHost;
+
+TEST(ExtensionRootContextTest, ConfigureSetsTickPeriod) {
+  FakeHost::get().reset();
+  ExtensionRootContext root(1, "root");
+  ASSERT_TRUE(root.onConfigure(0));
+  // Cache sweeps, snapshots and adaptive sampling run on tick.
+  EXPECT_EQ(1000, FakeHost::get().tickPeriodMilliseconds());
+}
+
+TEST(ExtensionStreamContextTest, UnsampledAccessorsDoNotCallHost) {
+  FakeHost::get().reset();
+  ExtensionRootContext root(1, "root");
+  SamplerConfig config;
+  config.rate = 0;
+  root.configureSampling(config);
+  ExtensionStreamContext stream(2, &root);
+  FakeHost::get().resetCounters();
+  EXPECT_FALSE(stream.sampled());
+  // The decision reads x-request-id only.
+  EXPECT_EQ(1, FakeHost::get().counters().reads);
+
+  FakeHost::get().resetCounters();
+  EXPECT_TRUE(stream.awaitPeerNodeInfo());
+  EXPECT_EQ("", stream.sourceName());
+  EXPECT_EQ("", stream.destinationWorkloadName());
+  EXPECT_EQ(0, stream.destinationPort());
+  EXPECT_EQ(0, stream.responseCode());
+  EXPECT_EQ(0, stream.responseFlags());
+  EXPECT_EQ("", stream.responseFlag());
+  EXPECT_EQ(0, stream.requestTime());
+  EXPECT_EQ(0, stream.requestDuration());
+  EXPECT_EQ(0, stream.requestTotalSize());
+  EXPECT_EQ(0, stream.responseTotalSize());
+  EXPECT_EQ(ServiceAuthenticationPolicy::Unspecified,
+            stream.serviceAuthenticationPolicy());
+  EXPECT_EQ("", stream.sourcePrincipal());
+  EXPECT_EQ("", stream.destinationPrincipal());
+  StringView host;
+  StringView name;
+  stream.destinationService(&host, &name);
+  EXPECT_EQ("", host);
+  EXPECT_EQ("", name);
+  EXPECT_EQ("http", stream.requestProtocol());
+  EXPECT_EQ(0, FakeHost::get().counters().reads);
+}
+
+} // namespace
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,124 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/grpc/frame_parser.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Istio {
+namespace Extension {
+namespace Grpc {
+
+namespace {
+
+constexpr uint8_t kCompressedFlag = 0x1;
+
+size_t sizeBucket(uint32_t size) {
+  return size == 0 ? 0 : 32 - __builtin_clz(size);
+}
+
+uint32_t readBigEndian32(const char *data) {
+  auto bytes = reinterpret_cast<const uint8_t *>(data);
+  return (static_cast<uint32_t>(bytes[0]) << 24) |
+         (static_cast<uint32_t>(bytes[1]) << 16) |
+         (static_cast<uint32_t>(bytes[2]) << 8) |
+         static_cast<uint32_t>(bytes[3]);
+}
+
+} // namespace
+
+template <typename Reader>
+void FrameParser::parseChunk(size_t chunk_size, bool end_of_stream,
+                             const Reader &read) {
+  if (malformed_) {
+    return;
+  }
+  size_t offset = 0;
+  while (offset < chunk_size) {
+    if (remaining_ > 0) {
+      // Skip the message body without reading it.
+      auto skipped = std::min<uint64_t>(remaining_, chunk_size - offset);
+      remaining_ -= skipped;
+      offset += skipped;
+      continue;
+    }
+    auto size = std::min(kFrameHeaderSize - header_size_, chunk_size - offset);
+    if (!read(offset, size, header_ + header_size_)) {
+      LOG_DEBUG("cannot read gRPC message prefix from body");
+      malformed_ = true;
+      return;
+    }
+    header_size_ += size;
+    offset += size;
+    if (header_size_ == kFrameHeaderSize) {
+      onHeader();
+      if (malformed_) {
+        return;
+      }
+    }
+  }
+  if (end_of_stream && (remaining_ > 0 || header_size_ > 0)) {
+    truncated_ = true;
+  }
+}
+
+void FrameParser::onBody(size_t chunk_size, bool end_of_stream) {
+  parseChunk(chunk_size, end_of_stream,
+             [this](size_t offset, size_t size, char *out) {
+               auto data = getBufferBytes(buffer_type_, offset, size);
+               if (!data || data->size() != size) {
+                 return false;
+               }
+               std::memcpy(out, data->data(), size);
+               return true;
+             });
+}
+
+void FrameParser::parse(StringView chunk, bool end_of_stream) {
+  parseChunk(chunk.size(), end_of_stream,
+             [chunk](size_t offset, size_t size, char *out) {
+               std::memcpy(out, chunk.data() + offset, size);
+               return true;
+             });
+}
+
+void FrameParser::onHeader() {
+  header_size_ = 0;
+  auto flags = static_cast<uint8_t>(header_[0]);
+  if ((flags & ~kCompressedFlag) != 0) {
+    malformed_ = true;
+    return;
+  }
+  uint32_t size = readBigEndian32(header_ + 1);
+  bool compressed = (flags & kCompressedFlag) != 0;
+
+  if (stats_.messages == 0 || size < stats_.min_size) {
+    stats_.min_size = size;
+  }
+  stats_.max_size = std::max(stats_.max_size, size);
+  stats_.messages++;
+  stats_.compressed_messages += compressed ? 1 : 0;
+  stats_.bytes += size;
+  stats_.size_buckets[sizeBucket(size)]++;
+  remaining_ = size;
+  if (callback_) {
+    callback_(size, compressed);
+  }
+}
+
+} // namespace Grpc
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,111 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+namespace Grpc {
+
+// Size of the gRPC message prefix: a compressed flag byte followed by the
+// message length as a big endian uint32.
+constexpr size_t kFrameHeaderSize = 5;
+
+// Message sizes are counted in power of two buckets: bucket 0 holds empty
+// messages and bucket i holds sizes in [2^(i-1), 2^i).
+constexpr size_t kMessageSizeBuckets = 33;
+
+struct MessageStats {
+  // Messages whose prefix has been seen, including one still in progress.
+  uint64_t messages = 0;
+  uint64_t compressed_messages = 0;
+  // Sum of message sizes, excluding prefixes.
+  uint64_t bytes = 0;
+  uint32_t min_size = 0;
+  uint32_t max_size = 0;
+  std::array<uint64_t, kMessageSizeBuckets> size_buckets{};
+};
+
+// Called with the size and compressed flag of each message, once its prefix
+// is parsed.
+typedef std::function<void(uint32_t size, bool compressed)> MessageCallback;
+
+// FrameParser counts gRPC messages of one direction of a stream as body
+// chunks arrive, without buffering the body. Only message prefixes are read
+// from host, which costs at most two small host calls per message, and state
+// carried between chunks is fixed in size, however long the stream is.
+//
+// The stream context must let chunks through, i.e. return Continue from body
+// callbacks, so that each callback delivers only the new chunk. A typical
+// use is:
+//
+//   FilterDataStatus onResponseBody(size_t body_size, bool end_of_stream) {
+//     response_frames_.onBody(body_size, end_of_stream);
+//     return FilterDataStatus::Continue;
+//   }
+class FrameParser {
+public:
+  explicit FrameParser(BufferType buffer_type) : buffer_type_(buffer_type) {}
+
+  void setCallback(MessageCallback callback) {
+    callback_ = std::move(callback);
+  }
+
+  // Parses a body chunk of the given size held by host.
+  void onBody(size_t chunk_size, bool end_of_stream);
+
+  // Same as above for a chunk held in memory.
+  void parse(StringView chunk, bool end_of_stream);
+
+  const MessageStats &stats() const { return stats_; }
+
+  // Whether the stream carried something other than gRPC messages, or a
+  // message prefix could not be read from host. Parsing stops once the stream
+  // is malformed.
+  bool malformed() const { return malformed_; }
+
+  // Whether the stream ended within a message or its prefix.
+  bool truncated() const { return truncated_; }
+
+private:
+  // Reader copies size bytes of the current chunk at offset to out, and
+  // returns false if they are not available.
+  template <typename Reader>
+  void parseChunk(size_t chunk_size, bool end_of_stream, const Reader &read);
+  void onHeader();
+
+  const BufferType buffer_type_;
+  MessageCallback callback_;
+  MessageStats stats_;
+
+  // Bytes of the current message not seen yet.
+  uint64_t remaining_ = 0;
+  // Prefix of the next message, which may span chunks.
+  char header_[kFrameHeaderSize];
+  size_t header_size_ = 0;
+
+  bool malformed_ = false;
+  bool truncated_ = false;
+};
+
+} // namespace Grpc
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,138 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "istio/extension/grpc/frame_parser.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Istio {
+namespace Extension {
+namespace Grpc {
+namespace {
+
+// Serializes a message prefix with the given flags byte.
+std::string prefix(uint32_t size, uint8_t flags = 0) {
+  return std::string{static_cast<char>(flags),
+                     static_cast<char>(size >> 24),
+                     static_cast<char>(size >> 16),
+                     static_cast<char>(size >> 8), static_cast<char>(size)};
+}
+
+std::string message(uint32_t size, bool compressed = false) {
+  return prefix(size, compressed ? 1 : 0) + std::string(size, 'x');
+}
+
+class FrameParserTest : public testing::Test {
+protected:
+  void SetUp() override {
+    parser_.setCallback([this](uint32_t size, bool compressed) {
+      messages_.emplace_back(size, compressed);
+    });
+  }
+
+  FrameParser parser_{BufferType::HttpRequestBody};
+  std::vector<std::pair<uint32_t, bool>> messages_;
+};
+
+TEST_F(FrameParserTest, ParsesMessagesOfOneChunk) {
+  parser_.parse(message(3) + message(300), true);
+  ASSERT_EQ(2, messages_.size());
+  EXPECT_EQ(3, messages_[0].first);
+  EXPECT_EQ(300, messages_[1].first);
+  const auto &stats = parser_.stats();
+  EXPECT_EQ(2, stats.messages);
+  EXPECT_EQ(303, stats.bytes);
+  EXPECT_EQ(3, stats.min_size);
+  EXPECT_EQ(300, stats.max_size);
+  EXPECT_EQ(1, stats.size_buckets[2]);
+  EXPECT_EQ(1, stats.size_buckets[9]);
+  EXPECT_FALSE(parser_.malformed());
+  EXPECT_FALSE(parser_.truncated());
+}
+
+TEST_F(FrameParserTest, ParsesPrefixSplitAcrossChunks) {
+  auto body = message(7) + message(258);
+  // Split before the second prefix, and within it at every offset.
+  size_t start = kFrameHeaderSize + 7;
+  for (size_t split = start; split < start + kFrameHeaderSize; split++) {
+    FrameParser parser(BufferType::HttpRequestBody);
+    parser.parse(body.substr(0, split), false);
+    EXPECT_EQ(1, parser.stats().messages);
+    parser.parse(body.substr(split), true);
+    EXPECT_EQ(2, parser.stats().messages);
+    EXPECT_EQ(265, parser.stats().bytes);
+    EXPECT_FALSE(parser.truncated());
+  }
+
+  // One byte chunks.
+  for (char byte : body) {
+    parser_.parse(StringView(&byte, 1), false);
+  }
+  parser_.parse({}, true);
+  ASSERT_EQ(2, messages_.size());
+  EXPECT_EQ(258, messages_[1].first);
+  EXPECT_FALSE(parser_.truncated());
+}
+
+TEST_F(FrameParserTest, CountsZeroLengthMessages) {
+  parser_.parse(message(0) + message(0), false);
+  parser_.parse(message(0), true);
+  ASSERT_EQ(3, messages_.size());
+  EXPECT_EQ(0, messages_[2].first);
+  EXPECT_EQ(3, parser_.stats().size_buckets[0]);
+  EXPECT_EQ(0, parser_.stats().bytes);
+  EXPECT_EQ(0, parser_.stats().min_size);
+  EXPECT_FALSE(parser_.truncated());
+}
+
+TEST_F(FrameParserTest, CountsCompressedMessages) {
+  parser_.parse(message(4, true) + message(4), true);
+  ASSERT_EQ(2, messages_.size());
+  EXPECT_TRUE(messages_[0].second);
+  EXPECT_FALSE(messages_[1].second);
+  EXPECT_EQ(1, parser_.stats().compressed_messages);
+}
+
+TEST_F(FrameParserTest, StopsOnInvalidFlags) {
+  parser_.parse(message(2) + prefix(2, 0x2) + "xx", false);
+  EXPECT_TRUE(parser_.malformed());
+  EXPECT_EQ(1, parser_.stats().messages);
+  // Nothing is parsed once malformed.
+  parser_.parse(message(2), true);
+  EXPECT_EQ(1, parser_.stats().messages);
+  EXPECT_EQ(1, messages_.size());
+}
+
+TEST_F(FrameParserTest, DetectsTruncationAtEndOfStream) {
+  parser_.parse(message(2) + prefix(10) + "xxx", true);
+  EXPECT_TRUE(parser_.truncated());
+  EXPECT_FALSE(parser_.malformed());
+
+  FrameParser within_prefix(BufferType::HttpRequestBody);
+  within_prefix.parse(message(2) + prefix(10).substr(0, 3), false);
+  within_prefix.parse({}, true);
+  EXPECT_TRUE(within_prefix.truncated());
+  EXPECT_EQ(1, within_prefix.stats().messages);
+}
+
+} // namespace
+} // namespace Grpc
+} // namespace Extension
+} // namespace Istio
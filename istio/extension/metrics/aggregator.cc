@@ -0,0 +1,173 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/aggregator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+namespace {
+
+constexpr StringView kRequestsTotal = "requests_total";
+constexpr StringView kRequestDuration = "request_duration_milliseconds";
+constexpr StringView kRequestBytes = "request_bytes";
+constexpr StringView kResponseBytes = "response_bytes";
+
+constexpr StringView kOverflowTagValue = "overflow";
+
+struct Quantile {
+  double q;
+  StringView suffix;
+};
+
+constexpr Quantile kQuantiles[] = {
+    {0.5, "_p50"},
+    {0.9, "_p90"},
+    {0.99, "_p99"},
+};
+
+std::string concat(StringView a, StringView b) {
+  std::string result(a.data(), a.size());
+  result.append(b.data(), b.size());
+  return result;
+}
+
+} // namespace
+
+RequestSample RequestSample::fromStream(ExtensionStreamContext &stream) {
+  RequestSample sample;
+  sample.duration_ms = stream.requestDuration() / 1e6;
+  sample.request_bytes = std::max<int64_t>(stream.requestTotalSize(), 0);
+  sample.response_bytes = std::max<int64_t>(stream.responseTotalSize(), 0);
+  return sample;
+}
+
+MetricAggregator::MetricAggregator(StringView prefix, size_t max_series,
+                                   uint32_t max_idle_flushes)
+    : prefix_(prefix), max_series_(max_series),
+      max_idle_flushes_(max_idle_flushes) {}
+
+void MetricAggregator::record(const TagBuffer &tags,
+                              const RequestSample &sample) {
+  auto &series = getSeries(tags);
+  series.requests++;
+  series.duration.sketch.add(sample.duration_ms);
+  series.request_bytes.sketch.add(sample.request_bytes);
+  series.response_bytes.sketch.add(sample.response_bytes);
+}
+
+MetricAggregator::Series &MetricAggregator::getSeries(const TagBuffer &tags) {
+  auto it = series_.find(tags.hash());
+  if (it != series_.end() && it->second.key == tags.key()) {
+    return it->second;
+  }
+  if (it == series_.end() && series_.size() < max_series_) {
+    return addSeries(tags);
+  }
+
+  // Cardinality limit is reached or hashes collide, fold the request into the
+  // overflow series of its reporter.
+  if (overflow_count_ == 0) {
+    LOG_WARN("metric series limit " + std::to_string(max_series_) +
+             " is reached, aggregating new tag tuples into overflow series");
+  }
+  overflow_count_++;
+  TagBuffer overflow;
+  overflow.buildOverflow(tags.get(Tag::Reporter), kOverflowTagValue);
+  auto overflow_it = series_.find(overflow.hash());
+  if (overflow_it != series_.end()) {
+    return overflow_it->second;
+  }
+  return addSeries(overflow);
+}
+
+MetricAggregator::Series &MetricAggregator::addSeries(const TagBuffer &tags) {
+  auto &series = series_[tags.hash()];
+  series.key.assign(tags.key().data(), tags.key().size());
+  return series;
+}
+
+void MetricAggregator::flush() {
+  for (auto it = series_.begin(); it != series_.end();) {
+    auto &series = it->second;
+    if (series.requests == 0) {
+      if (++series.idle_flushes >= max_idle_flushes_) {
+        it = series_.erase(it);
+      } else {
+        ++it;
+      }
+      continue;
+    }
+    series.idle_flushes = 0;
+    if (!series.defined) {
+      defineSeries(&series);
+    }
+    incrementMetric(series.requests_id, series.requests);
+    series.requests = 0;
+    flushDistribution(&series.duration);
+    flushDistribution(&series.request_bytes);
+    flushDistribution(&series.response_bytes);
+    ++it;
+  }
+}
+
+void MetricAggregator::defineSeries(Series *series) {
+  defineMetric(MetricType::Counter,
+               TagBuffer::statName(series->key, prefix_, kRequestsTotal),
+               &series->requests_id);
+  defineDistribution(series->key, kRequestDuration, &series->duration);
+  defineDistribution(series->key, kRequestBytes, &series->request_bytes);
+  defineDistribution(series->key, kResponseBytes, &series->response_bytes);
+  series->defined = true;
+}
+
+void MetricAggregator::defineDistribution(StringView key, StringView name,
+                                          Distribution *distribution) {
+  defineMetric(MetricType::Counter,
+               TagBuffer::statName(key, prefix_, concat(name, "_count")),
+               &distribution->count_id);
+  defineMetric(MetricType::Counter,
+               TagBuffer::statName(key, prefix_, concat(name, "_sum")),
+               &distribution->sum_id);
+  for (const auto &quantile : kQuantiles) {
+    uint32_t metric_id = 0;
+    auto stat_name =
+        TagBuffer::statName(key, prefix_, concat(name, quantile.suffix));
+    defineMetric(MetricType::Gauge, stat_name, &metric_id);
+    distribution->quantile_ids.push_back(metric_id);
+  }
+}
+
+void MetricAggregator::flushDistribution(Distribution *distribution) {
+  auto &sketch = distribution->sketch;
+  if (sketch.empty()) {
+    return;
+  }
+  incrementMetric(distribution->count_id, sketch.count());
+  incrementMetric(distribution->sum_id, std::llround(sketch.sum()));
+  for (size_t i = 0; i < distribution->quantile_ids.size(); i++) {
+    recordMetric(distribution->quantile_ids[i],
+                 std::llround(sketch.quantile(kQuantiles[i].q)));
+  }
+  sketch.clear();
+}
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,112 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "istio/extension/metrics/sketch.h"
+#include "istio/extension/metrics/tags.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+const size_t DefaultMaxSeries = 1000;
+const uint32_t DefaultMaxIdleFlushes = 60;
+
+// Values of a finished request which are aggregated per tag tuple.
+struct RequestSample {
+  double duration_ms = 0;
+  uint64_t request_bytes = 0;
+  uint64_t response_bytes = 0;
+
+  // Gets request duration and sizes of a stream. Should be called at onLog,
+  // when these values are final.
+  static RequestSample fromStream(ExtensionStreamContext &stream);
+};
+
+// MetricAggregator accumulates standard Istio request metrics in Wasm memory,
+// keyed by the hashed Istio tag tuple, and flushes them to host metrics in a
+// batch. MetricsRootContext owns one, which its MetricsStreamContext streams
+// record into at onLog, and flushes it on tick.
+//
+// Request counts are flushed into a counter. Since host histograms can only
+// record one value per call, distributions are flushed as _count and _sum
+// counters plus per interval quantile gauges, e.g. _p99.
+//
+// The number of tag tuples is bounded. Once max_series is reached, requests
+// with new tag tuples are aggregated into a single overflow series. Series
+// without requests for max_idle_flushes flushes are evicted, so that tag
+// tuples which went away, e.g. of rescheduled pods, free their slots. Host
+// keeps the metrics already defined for them.
+class MetricAggregator {
+public:
+  explicit MetricAggregator(StringView prefix = "istio_",
+                            size_t max_series = DefaultMaxSeries,
+                            uint32_t max_idle_flushes = DefaultMaxIdleFlushes);
+
+  // Records a finished request. This only touches Wasm memory, and does not
+  // allocate unless the tag tuple is new.
+  void record(const TagBuffer &tags, const RequestSample &sample);
+
+  // Flushes values aggregated since the previous flush to host, and evicts
+  // idle series.
+  void flush();
+
+  size_t seriesCount() const { return series_.size(); }
+
+  // Number of requests aggregated into the overflow series.
+  uint64_t overflowCount() const { return overflow_count_; }
+
+private:
+  struct Distribution {
+    LatencySketch sketch;
+    uint32_t count_id = 0;
+    uint32_t sum_id = 0;
+    std::vector<uint32_t> quantile_ids;
+  };
+
+  struct Series {
+    // Encoded tag tuple, used to detect hash collisions and build stat names.
+    std::string key;
+    bool defined = false;
+    // Consecutive flushes without requests.
+    uint32_t idle_flushes = 0;
+    uint64_t requests = 0;
+    uint32_t requests_id = 0;
+    Distribution duration;
+    Distribution request_bytes;
+    Distribution response_bytes;
+  };
+
+  Series &getSeries(const TagBuffer &tags);
+  Series &addSeries(const TagBuffer &tags);
+  void defineSeries(Series *series);
+  void defineDistribution(StringView key, StringView name,
+                          Distribution *distribution);
+  void flushDistribution(Distribution *distribution);
+
+  std::string prefix_;
+  size_t max_series_;
+  uint32_t max_idle_flushes_;
+  uint64_t overflow_count_ = 0;
+
+  std::unordered_map<uint64_t, Series> series_;
+};
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,160 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/aggregator.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswer;
+using Replay::HostAnswers;
+
+TagBuffer makeTags(StringView workload) {
+  TagBuffer tags;
+  tags.append("destination");
+  tags.append(workload);
+  for (size_t i = 2; i < kTagCount; i++) {
+    tags.append("v");
+  }
+  return tags;
+}
+
+int64_t metricValue(StringView key, StringView name) {
+  auto *metric =
+      FakeHost::get().metric(TagBuffer::statName(key, "istio_", name));
+  return metric == nullptr ? -1 : metric->value;
+}
+
+RequestSample sample(double duration_ms, uint64_t bytes) {
+  RequestSample sample;
+  sample.duration_ms = duration_ms;
+  sample.request_bytes = bytes;
+  sample.response_bytes = 2 * bytes;
+  return sample;
+}
+
+class MetricAggregatorTest : public testing::Test {
+protected:
+  void SetUp() override { FakeHost::get().reset(); }
+};
+
+TEST_F(MetricAggregatorTest, FlushesAggregatedValues) {
+  MetricAggregator aggregator;
+  auto tags = makeTags("a");
+  aggregator.record(tags, sample(10, 100));
+  aggregator.record(tags, sample(30, 300));
+  EXPECT_TRUE(FakeHost::get().metrics().empty());
+
+  aggregator.flush();
+  EXPECT_EQ(1, aggregator.seriesCount());
+  EXPECT_EQ(2, metricValue(tags.key(), "requests_total"));
+  EXPECT_EQ(2, metricValue(tags.key(), "request_duration_milliseconds_count"));
+  EXPECT_EQ(40, metricValue(tags.key(), "request_duration_milliseconds_sum"));
+  EXPECT_EQ(400, metricValue(tags.key(), "request_bytes_sum"));
+  EXPECT_EQ(800, metricValue(tags.key(), "response_bytes_sum"));
+  // With two values, ranks below one are answered with the lower one.
+  EXPECT_NEAR(10, metricValue(tags.key(), "request_duration_milliseconds_p50"),
+              1);
+
+  // Counters are incremented by what was recorded since the last flush.
+  aggregator.record(tags, sample(20, 100));
+  aggregator.flush();
+  EXPECT_EQ(3, metricValue(tags.key(), "requests_total"));
+  EXPECT_EQ(60, metricValue(tags.key(), "request_duration_milliseconds_sum"));
+  EXPECT_NEAR(20, metricValue(tags.key(), "request_duration_milliseconds_p50"),
+              1);
+}
+
+TEST_F(MetricAggregatorTest, OverflowSeries) {
+  MetricAggregator aggregator("istio_", 2);
+  aggregator.record(makeTags("a"), sample(1, 1));
+  aggregator.record(makeTags("b"), sample(1, 1));
+  aggregator.record(makeTags("c"), sample(1, 1));
+  aggregator.record(makeTags("d"), sample(1, 1));
+  EXPECT_EQ(3, aggregator.seriesCount());
+  EXPECT_EQ(2, aggregator.overflowCount());
+
+  aggregator.flush();
+  TagBuffer overflow;
+  overflow.buildOverflow("destination", "overflow");
+  EXPECT_EQ(2, metricValue(overflow.key(), "requests_total"));
+  EXPECT_EQ(1, metricValue(makeTags("a").key(), "requests_total"));
+}
+
+TEST_F(MetricAggregatorTest, EvictsIdleSeries) {
+  MetricAggregator aggregator("istio_", 2, 3);
+  aggregator.record(makeTags("a"), sample(1, 1));
+  aggregator.record(makeTags("b"), sample(1, 1));
+  aggregator.flush();
+  for (int i = 0; i < 2; i++) {
+    aggregator.record(makeTags("b"), sample(1, 1));
+    aggregator.flush();
+  }
+  // a was idle for two flushes, so it is kept.
+  EXPECT_EQ(2, aggregator.seriesCount());
+  aggregator.record(makeTags("b"), sample(1, 1));
+  aggregator.flush();
+  EXPECT_EQ(1, aggregator.seriesCount());
+
+  // The freed slot is used by a new tag tuple instead of the overflow series.
+  aggregator.record(makeTags("c"), sample(1, 1));
+  EXPECT_EQ(2, aggregator.seriesCount());
+  EXPECT_EQ(0, aggregator.overflowCount());
+
+  // An evicted series is recreated, and keeps counting into its host metric.
+  aggregator.record(makeTags("b"), sample(1, 1));
+  aggregator.flush();
+  EXPECT_EQ(5, metricValue(makeTags("b").key(), "requests_total"));
+}
+
+std::string int64Bytes(int64_t value) {
+  std::string bytes(sizeof(value), '\0');
+  std::memcpy(&bytes[0], &value, sizeof(value));
+  return bytes;
+}
+
+TEST_F(MetricAggregatorTest, SampleFromStream) {
+  HostAnswers answers;
+  answers[std::string("request\0duration", 16)] =
+      HostAnswer{true, int64Bytes(25000000)};
+  answers[std::string("request\0total_size", 18)] =
+      HostAnswer{true, int64Bytes(120)};
+  answers[std::string("response\0total_size", 19)] =
+      HostAnswer{true, int64Bytes(480)};
+  FakeHost::get().setStreamAnswers(&answers);
+
+  ExtensionRootContext root(1, "");
+  root.declareAttributes(attributeSet(Attribute::ResponseTotalSize));
+  ExtensionStreamContext stream(2, &root);
+  auto result = RequestSample::fromStream(stream);
+  FakeHost::get().setStreamAnswers(nullptr);
+
+  EXPECT_DOUBLE_EQ(25, result.duration_ms);
+  EXPECT_EQ(120, result.request_bytes);
+  EXPECT_EQ(480, result.response_bytes);
+}
+
+} // namespace
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
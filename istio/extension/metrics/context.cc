@@ -0,0 +1,47 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/context.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+void MetricsRootContext::onTick() {
+  ExtensionRootContext::onTick();
+  aggregator_.flush();
+}
+
+bool MetricsRootContext::onDone() {
+  aggregator_.flush();
+  return ExtensionRootContext::onDone();
+}
+
+void MetricsStreamContext::onLog() {
+  if (!sampled()) {
+    return;
+  }
+  auto *root = dynamic_cast<MetricsRootContext *>(this->root());
+  if (root == nullptr) {
+    return;
+  }
+  TagBuffer tags;
+  tags.build(*this);
+  root->metricAggregator().record(tags, RequestSample::fromStream(*this));
+}
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,59 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "istio/extension/extension.h"
+#include "istio/extension/metrics/aggregator.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+// MetricsRootContext owns a MetricAggregator for the standard Istio request
+// metrics of its streams, and flushes it to host on tick and when the plugin
+// is done. Aggregation lives here rather than in ExtensionRootContext, as the
+// metrics library builds on the extension library.
+class MetricsRootContext : public ExtensionRootContext {
+public:
+  MetricsRootContext(uint32_t id, StringView root_id,
+                     StringView prefix = "istio_",
+                     size_t max_series = DefaultMaxSeries)
+      : ExtensionRootContext(id, root_id), aggregator_(prefix, max_series) {}
+
+  // Subclasses overriding onTick or onDone must call the base implementation.
+  void onTick() override;
+  bool onDone() override;
+
+  MetricAggregator &metricAggregator() { return aggregator_; }
+
+private:
+  MetricAggregator aggregator_;
+};
+
+// MetricsStreamContext records every sampled request into the aggregator of
+// its MetricsRootContext at onLog. Subclasses overriding onLog must call the
+// base implementation.
+class MetricsStreamContext : public ExtensionStreamContext {
+public:
+  MetricsStreamContext(uint32_t id, RootContext *root)
+      : ExtensionStreamContext(id, root) {}
+
+  void onLog() override;
+};
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
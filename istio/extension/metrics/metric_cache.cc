@@ -0,0 +1,63 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/metric_cache.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+MetricCache::MetricCache(MetricType type, StringView prefix, StringView name,
+                         size_t max_size)
+    : type_(type), prefix_(prefix), name_(name), max_size_(max_size) {}
+
+uint32_t MetricCache::resolve(const TagBuffer &tags) {
+  auto key = tags.key();
+  auto it = cache_.find(tags.hash());
+  if (it != cache_.end()) {
+    if (it->second.key == key) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return it->second.metric_id;
+    }
+    // Hash collision, resolve the metric without caching it.
+    return define(key);
+  }
+
+  // Do not let the cache grow beyond max_size_. Metrics stay defined in host,
+  // evicted tag tuples are resolved again on next use.
+  while (!lru_.empty() && cache_.size() >= max_size_) {
+    cache_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  auto metric_id = define(key);
+  lru_.push_front(tags.hash());
+  cache_.emplace(tags.hash(), Entry{std::string(key.data(), key.size()),
+                                    metric_id, lru_.begin()});
+  return metric_id;
+}
+
+uint32_t MetricCache::define(StringView key) {
+  uint32_t metric_id = 0;
+  auto result =
+      defineMetric(type_, TagBuffer::statName(key, prefix_, name_), &metric_id);
+  if (result != WasmResult::Ok) {
+    LOG_WARN("cannot define metric " + name_ + ": " + toString(result));
+  }
+  return metric_id;
+}
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,67 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+#include "istio/extension/metrics/tags.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+const size_t DefaultMetricCacheMaxSize = 1000;
+
+// MetricCache maps tag tuples of one metric to resolved host metric ids. It
+// is keyed by the hash computed while the tag buffer is written, so a cache
+// hit needs no stat name building and no host call. Owned by a root context.
+// Once max_size tag tuples are cached, the least recently used is evicted.
+class MetricCache {
+public:
+  MetricCache(MetricType type, StringView prefix, StringView name,
+              size_t max_size = DefaultMetricCacheMaxSize);
+
+  // Gets id of the metric with the given tags. The metric is defined in host
+  // on first use of a tag tuple.
+  uint32_t resolve(const TagBuffer &tags);
+
+  size_t size() const { return cache_.size(); }
+
+private:
+  struct Entry {
+    // Encoded tag tuple, used to detect hash collisions.
+    std::string key;
+    uint32_t metric_id;
+    // Position in lru_.
+    std::list<uint64_t>::iterator lru;
+  };
+
+  uint32_t define(StringView key);
+
+  MetricType type_;
+  std::string prefix_;
+  std::string name_;
+  size_t max_size_;
+
+  std::unordered_map<uint64_t, Entry> cache_;
+  // Hashes of cached tag tuples, most recently used first.
+  std::list<uint64_t> lru_;
+};
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
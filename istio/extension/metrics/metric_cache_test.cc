@@ -0,0 +1,58 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/metric_cache.h"
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+namespace {
+
+using Replay::FakeHost;
+
+TagBuffer makeTags(StringView workload) {
+  TagBuffer tags;
+  tags.append("destination");
+  tags.append(workload);
+  return tags;
+}
+
+TEST(MetricCacheTest, EvictsLeastRecentlyUsed) {
+  FakeHost::get().reset();
+  MetricCache cache(MetricType::Counter, "istio_", "requests_total", 2);
+  auto a = cache.resolve(makeTags("a"));
+  auto b = cache.resolve(makeTags("b"));
+  EXPECT_NE(a, b);
+  EXPECT_EQ(2, FakeHost::get().metrics().size());
+
+  // a is used more recently than b, so c evicts b.
+  EXPECT_EQ(a, cache.resolve(makeTags("a")));
+  cache.resolve(makeTags("c"));
+  EXPECT_EQ(2, cache.size());
+
+  // a is still cached, b is resolved again to the same host metric.
+  EXPECT_EQ(a, cache.resolve(makeTags("a")));
+  EXPECT_EQ(b, cache.resolve(makeTags("b")));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(3, FakeHost::get().metrics().size());
+}
+
+} // namespace
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,117 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/sketch.h"
+
+#include <cmath>
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+namespace {
+
+// Values below this are counted in the zero bin.
+constexpr double kMinIndexableValue = 1e-9;
+
+} // namespace
+
+LatencySketch::LatencySketch(double relative_accuracy, size_t max_bins)
+    : gamma_((1 + relative_accuracy) / (1 - relative_accuracy)),
+      multiplier_(1 / std::log(gamma_)), max_bins_(max_bins) {}
+
+int32_t LatencySketch::binIndex(double value) const {
+  return static_cast<int32_t>(std::ceil(std::log(value) * multiplier_));
+}
+
+double LatencySketch::binValue(int32_t index) const {
+  return 2 * std::pow(gamma_, index) / (gamma_ + 1);
+}
+
+void LatencySketch::add(double value) {
+  if (value < kMinIndexableValue) {
+    zero_count_++;
+  } else {
+    addToBin(binIndex(value), 1);
+  }
+  count_++;
+  sum_ += value;
+}
+
+void LatencySketch::addToBin(int32_t index, uint64_t count) {
+  if (bins_.empty()) {
+    bins_.push_back(count);
+    offset_ = index;
+    return;
+  }
+  if (index < offset_) {
+    bins_.insert(bins_.begin(), offset_ - index, 0);
+    offset_ = index;
+  } else if (index >= offset_ + static_cast<int32_t>(bins_.size())) {
+    bins_.resize(index - offset_ + 1, 0);
+  }
+  bins_[index - offset_] += count;
+
+  if (bins_.size() > max_bins_) {
+    // Collapse the lowest bins into the lowest remaining one.
+    size_t collapsed = bins_.size() - max_bins_;
+    for (size_t i = 0; i < collapsed; i++) {
+      bins_[collapsed] += bins_[i];
+    }
+    bins_.erase(bins_.begin(), bins_.begin() + collapsed);
+    offset_ += static_cast<int32_t>(collapsed);
+  }
+}
+
+void LatencySketch::merge(const LatencySketch &other) {
+  for (size_t i = 0; i < other.bins_.size(); i++) {
+    if (other.bins_[i] != 0) {
+      addToBin(other.offset_ + static_cast<int32_t>(i), other.bins_[i]);
+    }
+  }
+  zero_count_ += other.zero_count_;
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+double LatencySketch::quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(q * (count_ - 1));
+  uint64_t seen = zero_count_;
+  if (seen > rank) {
+    return 0;
+  }
+  for (size_t i = 0; i < bins_.size(); i++) {
+    seen += bins_[i];
+    if (seen > rank) {
+      return binValue(offset_ + static_cast<int32_t>(i));
+    }
+  }
+  return binValue(offset_ + static_cast<int32_t>(bins_.size()) - 1);
+}
+
+void LatencySketch::clear() {
+  bins_.clear();
+  offset_ = 0;
+  zero_count_ = 0;
+  count_ = 0;
+  sum_ = 0;
+}
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,78 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+const double DefaultSketchRelativeAccuracy = 0.01;
+const size_t DefaultSketchMaxBins = 1024;
+
+// LatencySketch is a mergeable quantile sketch following DDSketch: values are
+// counted in logarithmically sized bins, so every quantile is answered within
+// the configured relative accuracy. When the number of bins exceeds the limit,
+// the lowest bins are collapsed, which keeps high quantiles accurate.
+class LatencySketch {
+public:
+  explicit LatencySketch(
+      double relative_accuracy = DefaultSketchRelativeAccuracy,
+      size_t max_bins = DefaultSketchMaxBins);
+
+  // Adds a non-negative value.
+  void add(double value);
+
+  // Merges another sketch which has the same relative accuracy.
+  void merge(const LatencySketch &other);
+
+  // Gets the value at quantile q in [0, 1]. Returns 0 if the sketch is empty.
+  double quantile(double q) const;
+
+  uint64_t count() const { return count_; }
+  double sum() const { return sum_; }
+  bool empty() const { return count_ == 0; }
+
+  void clear();
+
+private:
+  int32_t binIndex(double value) const;
+  double binValue(int32_t index) const;
+
+  // Adds count to the bin at index, growing and collapsing bins as needed.
+  void addToBin(int32_t index, uint64_t count);
+
+  double gamma_;
+  double multiplier_;
+  size_t max_bins_;
+
+  // Counts of bins, bins_[0] holds the bin at index offset_.
+  std::vector<uint64_t> bins_;
+  int32_t offset_ = 0;
+
+  // Values too small to be indexed.
+  uint64_t zero_count_ = 0;
+
+  uint64_t count_ = 0;
+  double sum_ = 0;
+};
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,107 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/sketch.h"
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+namespace {
+
+// Checks that value is within the relative accuracy of expected.
+void expectWithin(double expected, double value, double accuracy) {
+  EXPECT_LE(std::abs(value - expected), expected * accuracy)
+      << "expected " << expected << ", got " << value;
+}
+
+TEST(LatencySketchTest, Empty) {
+  LatencySketch sketch;
+  EXPECT_TRUE(sketch.empty());
+  EXPECT_EQ(0, sketch.count());
+  EXPECT_EQ(0, sketch.quantile(0.5));
+}
+
+TEST(LatencySketchTest, QuantilesWithinRelativeAccuracy) {
+  LatencySketch sketch(0.01);
+  for (int i = 1; i <= 10000; i++) {
+    sketch.add(i);
+  }
+  EXPECT_EQ(10000, sketch.count());
+  EXPECT_DOUBLE_EQ(50005000, sketch.sum());
+  expectWithin(1, sketch.quantile(0), 0.01);
+  expectWithin(5000, sketch.quantile(0.5), 0.01);
+  expectWithin(9000, sketch.quantile(0.9), 0.01);
+  expectWithin(9900, sketch.quantile(0.99), 0.01);
+  expectWithin(10000, sketch.quantile(1), 0.01);
+}
+
+TEST(LatencySketchTest, ZeroValues) {
+  LatencySketch sketch;
+  for (int i = 0; i < 60; i++) {
+    sketch.add(0);
+  }
+  for (int i = 0; i < 40; i++) {
+    sketch.add(100);
+  }
+  EXPECT_EQ(0, sketch.quantile(0.5));
+  expectWithin(100, sketch.quantile(0.9), 0.01);
+}
+
+TEST(LatencySketchTest, MergeMatchesSingleSketch) {
+  LatencySketch all;
+  LatencySketch low;
+  LatencySketch high;
+  for (int i = 1; i <= 1000; i++) {
+    all.add(i);
+    (i <= 500 ? low : high).add(i);
+  }
+  low.merge(high);
+  EXPECT_EQ(all.count(), low.count());
+  EXPECT_DOUBLE_EQ(all.sum(), low.sum());
+  for (double q : {0.0, 0.25, 0.5, 0.9, 0.99, 1.0}) {
+    EXPECT_DOUBLE_EQ(all.quantile(q), low.quantile(q)) << "q=" << q;
+  }
+}
+
+TEST(LatencySketchTest, CollapseKeepsHighQuantiles) {
+  // With 1% accuracy, values spanning 1 to 1e6 need about 700 bins.
+  LatencySketch sketch(0.01, 64);
+  for (int i = 0; i < 100000; i++) {
+    sketch.add(1 + (i % 1000) * 1000.0);
+  }
+  expectWithin(990001, sketch.quantile(0.99), 0.01);
+  expectWithin(900001, sketch.quantile(0.9), 0.01);
+  // Collapsed low values are reported as the lowest remaining bin.
+  EXPECT_GT(sketch.quantile(0), 1);
+}
+
+TEST(LatencySketchTest, Clear) {
+  LatencySketch sketch;
+  sketch.add(10);
+  sketch.clear();
+  EXPECT_TRUE(sketch.empty());
+  EXPECT_EQ(0, sketch.sum());
+  sketch.add(20);
+  expectWithin(20, sketch.quantile(0.5), 0.01);
+}
+
+} // namespace
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,191 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/tags.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+namespace {
+
+constexpr std::array<StringView, kTagCount> kTagNames{
+    "reporter",
+    "source_workload",
+    "source_workload_namespace",
+    "source_principal",
+    "destination_workload",
+    "destination_workload_namespace",
+    "destination_principal",
+    "destination_service",
+    "destination_service_name",
+    "destination_service_namespace",
+    "request_protocol",
+    "response_code",
+    "response_flags",
+    "connection_security_policy",
+};
+
+// Separators matched by the tag extraction regexes in Istio bootstrap.
+constexpr StringView kValueSeparator = "=.=";
+constexpr StringView kFieldSeparator = ";.;";
+
+constexpr StringView kReporterSource = "source";
+constexpr StringView kReporterDestination = "destination";
+
+// Each value is prefixed with its length as a base 128 varint.
+constexpr size_t kMaxLengthSize = 10;
+
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+// Formats a non-negative integer into the end of buffer without allocation.
+StringView formatInt(int64_t value, char (&buffer)[24]) {
+  char *end = buffer + sizeof(buffer);
+  char *begin = end;
+  uint64_t v = value < 0 ? 0 : value;
+  do {
+    *--begin = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  return StringView(begin, end - begin);
+}
+
+// Iterates values of an encoded tag tuple. Returns false at the end.
+bool nextValue(StringView key, size_t *pos, StringView *value) {
+  size_t length = 0;
+  for (uint32_t shift = 0;; shift += 7) {
+    if (*pos == key.size()) {
+      return false;
+    }
+    auto byte = static_cast<uint8_t>(key[(*pos)++]);
+    length |= static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  length = std::min(length, key.size() - *pos);
+  *value = key.substr(*pos, length);
+  *pos += length;
+  return true;
+}
+
+} // namespace
+
+StringView tagName(Tag tag) { return kTagNames[static_cast<size_t>(tag)]; }
+
+void TagBuffer::build(ExtensionStreamContext &stream) {
+  clear();
+  append(stream.isOutbound() ? kReporterSource : kReporterDestination);
+  append(stream.sourceWorkloadName());
+  append(stream.sourceNamespace());
+  append(stream.sourcePrincipal());
+  append(stream.destinationWorkloadName());
+  const auto &destination_namespace = stream.destinationNamespace();
+  append(destination_namespace);
+  append(stream.destinationPrincipal());
+  StringView service_host;
+  StringView service_name;
+  stream.destinationService(&service_host, &service_name);
+  append(service_host);
+  append(service_name);
+  append(destination_namespace);
+  append(stream.requestProtocol());
+  char response_code[24];
+  append(formatInt(stream.responseCode(), response_code));
+  append(stream.responseFlag());
+  append(Util::authenticationPolicyString(
+      stream.serviceAuthenticationPolicy()));
+}
+
+void TagBuffer::buildOverflow(StringView reporter, StringView value) {
+  clear();
+  append(reporter);
+  for (size_t i = 1; i < kTagCount; i++) {
+    append(value);
+  }
+}
+
+void TagBuffer::append(StringView value) {
+  char length[kMaxLengthSize];
+  size_t length_size = 0;
+  size_t remaining = value.size();
+  do {
+    length[length_size] = static_cast<char>(remaining & 0x7f);
+    remaining >>= 7;
+    if (remaining != 0) {
+      length[length_size] |= 0x80;
+    }
+    length_size++;
+  } while (remaining != 0);
+  write(StringView(length, length_size));
+  write(value);
+}
+
+void TagBuffer::write(StringView bytes) {
+  if (!spilled_ && size_ + bytes.size() > kCapacity) {
+    heap_.assign(data_, size_);
+    spilled_ = true;
+  }
+  if (spilled_) {
+    heap_.append(bytes.data(), bytes.size());
+  } else {
+    std::memcpy(data_ + size_, bytes.data(), bytes.size());
+    size_ += bytes.size();
+  }
+  for (char byte : bytes) {
+    hash_ = (hash_ ^ static_cast<uint8_t>(byte)) * kFnvPrime;
+  }
+}
+
+void TagBuffer::clear() {
+  size_ = 0;
+  hash_ = kHashSeed;
+  heap_.clear();
+  spilled_ = false;
+}
+
+StringView TagBuffer::tagValue(StringView key, Tag tag) {
+  size_t pos = 0;
+  StringView value;
+  for (size_t i = 0; nextValue(key, &pos, &value); i++) {
+    if (i == static_cast<size_t>(tag)) {
+      return value;
+    }
+  }
+  return {};
+}
+
+std::string TagBuffer::statName(StringView key, StringView prefix,
+                                StringView name) {
+  std::string stat_name(prefix.data(), prefix.size());
+  size_t pos = 0;
+  StringView value;
+  for (size_t i = 0; i < kTagCount && nextValue(key, &pos, &value); i++) {
+    stat_name.append(kTagNames[i].data(), kTagNames[i].size())
+        .append(kValueSeparator.data(), kValueSeparator.size())
+        .append(value.data(), value.size())
+        .append(kFieldSeparator.data(), kFieldSeparator.size());
+  }
+  stat_name.append(name.data(), name.size());
+  return stat_name;
+}
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,109 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "istio/extension/extension.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+
+// Standard Istio metric tags, in the order they are encoded into stat names.
+enum class Tag : uint8_t {
+  Reporter = 0,
+  SourceWorkload,
+  SourceWorkloadNamespace,
+  SourcePrincipal,
+  DestinationWorkload,
+  DestinationWorkloadNamespace,
+  DestinationPrincipal,
+  DestinationService,
+  DestinationServiceName,
+  DestinationServiceNamespace,
+  RequestProtocol,
+  ResponseCode,
+  ResponseFlags,
+  ConnectionSecurityPolicy,
+};
+
+constexpr size_t kTagCount =
+    static_cast<size_t>(Tag::ConnectionSecurityPolicy) + 1;
+
+// Gets the tag name used in stat names, e.g. "source_workload".
+StringView tagName(Tag tag);
+
+// TagBuffer packs the standard Istio tag tuple of a request into a fixed size
+// buffer, and hashes it while it is being written. It is meant to live on the
+// stack, so that building and looking up a tag tuple needs no allocation.
+// Values are length prefixed and written in Tag order. A tuple which does not
+// fit is moved to the heap rather than truncated, so that distinct tuples are
+// never merged.
+class TagBuffer {
+public:
+  static constexpr size_t kCapacity = 1024;
+
+  // Writes the standard tags of a stream in one pass.
+  void build(ExtensionStreamContext &stream);
+
+  // Writes the standard tags with every value except reporter replaced by the
+  // given one.
+  void buildOverflow(StringView reporter, StringView value);
+
+  // Appends the value of the next tag.
+  void append(StringView value);
+
+  void clear();
+
+  // Encoded tag tuple, which identifies the tuple together with its hash.
+  StringView key() const {
+    return spilled_ ? StringView(heap_) : StringView(data_, size_);
+  }
+  uint64_t hash() const { return hash_; }
+
+  // Whether the tuple outgrew the fixed size buffer and lives on the heap.
+  bool spilled() const { return spilled_; }
+
+  // Gets value of a tag by scanning the buffer.
+  StringView get(Tag tag) const { return tagValue(key(), tag); }
+
+  // Decodes the value of a tag from an encoded tag tuple.
+  static StringView tagValue(StringView key, Tag tag);
+
+  // Encodes an encoded tag tuple into a stat name which Envoy tag extraction
+  // understands, e.g. istio_reporter=.=destination;.;...;.;requests_total.
+  static std::string statName(StringView key, StringView prefix,
+                              StringView name);
+
+private:
+  // FNV-1a offset basis.
+  static constexpr uint64_t kHashSeed = 14695981039346656037ULL;
+
+  // Appends encoded bytes and hashes them.
+  void write(StringView bytes);
+
+  char data_[kCapacity];
+  size_t size_ = 0;
+  uint64_t hash_ = kHashSeed;
+  // Tuple which outgrew data_, rare enough to allocate for.
+  std::string heap_;
+  bool spilled_ = false;
+};
+
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,83 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/metrics/tags.h"
+
+#include "gtest/gtest.h"
+
+namespace Istio {
+namespace Extension {
+namespace Metrics {
+namespace {
+
+TagBuffer makeTags(StringView workload) {
+  TagBuffer tags;
+  tags.append("destination");
+  tags.append(workload);
+  for (size_t i = 2; i < kTagCount; i++) {
+    tags.append("value");
+  }
+  return tags;
+}
+
+TEST(TagBufferTest, EncodesValuesInOrder) {
+  auto tags = makeTags("productpage");
+  EXPECT_FALSE(tags.spilled());
+  EXPECT_EQ("destination", tags.get(Tag::Reporter));
+  EXPECT_EQ("productpage", tags.get(Tag::SourceWorkload));
+  EXPECT_EQ("value", tags.get(Tag::ConnectionSecurityPolicy));
+  auto stat_name = TagBuffer::statName(tags.key(), "istio_", "requests_total");
+  EXPECT_EQ(0, stat_name.find("istio_reporter=.=destination;.;"
+                              "source_workload=.=productpage;.;"));
+}
+
+TEST(TagBufferTest, LongValuesSpillInsteadOfTruncating) {
+  // Both workloads overflow the fixed size buffer, and only differ at the end.
+  std::string a(TagBuffer::kCapacity + 100, 'x');
+  std::string b = a;
+  a.back() = 'a';
+  b.back() = 'b';
+  auto tags_a = makeTags(a);
+  auto tags_b = makeTags(b);
+  EXPECT_TRUE(tags_a.spilled());
+  EXPECT_EQ(a, tags_a.get(Tag::SourceWorkload));
+  EXPECT_EQ("value", tags_a.get(Tag::ConnectionSecurityPolicy));
+  EXPECT_NE(tags_a.key(), tags_b.key());
+  EXPECT_NE(tags_a.hash(), tags_b.hash());
+
+  // Hash does not depend on whether the tuple spilled.
+  TagBuffer copy;
+  for (size_t i = 0; i < kTagCount; i++) {
+    copy.append(tags_a.get(static_cast<Tag>(i)));
+  }
+  EXPECT_EQ(tags_a.key(), copy.key());
+  EXPECT_EQ(tags_a.hash(), copy.hash());
+}
+
+TEST(TagBufferTest, ClearResetsSpill) {
+  auto tags = makeTags(std::string(2 * TagBuffer::kCapacity, 'x'));
+  EXPECT_TRUE(tags.spilled());
+  tags.clear();
+  EXPECT_FALSE(tags.spilled());
+  EXPECT_TRUE(tags.key().empty());
+  tags.append("destination");
+  tags.append("a");
+  EXPECT_EQ("a", tags.get(Tag::SourceWorkload));
+}
+
+} // namespace
+} // namespace Metrics
+} // namespace Extension
+} // namespace Istio
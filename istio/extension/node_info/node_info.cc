@@ -16,7 +16,10 @@
 #include "istio/extension/node_info/node_info.h"
 
 #include "absl/strings/string_view.h"
+#ifndef ISTIO_WASM_SDK_LITE
 #include "google/protobuf/stubs/status.h"
+#endif
+#include "istio/extension/util/host_trace.h"
 #include "istio/extension/util/util.h"
 #include "proxy_wasm_intrinsics.h"
 
@@ -28,15 +31,31 @@ const istio::extension::NodeInfo EmptyNodeInfo;
 
 namespace {
 
+#ifdef ISTIO_WASM_SDK_LITE
+bool extractLocalNodeMetadata(istio::extension::NodeInfo *node_info) {
+  auto node = Util::readProperty({"node", "metadata"});
+  if (!node) {
+    LOG_WARN("cannot extract local node metadata: metadata not found");
+    return false;
+  }
+  if (!extractNodeMetadata((*node)->view(), node_info)) {
+    LOG_WARN("cannot extract local node metadata: malformed metadata");
+    return false;
+  }
+  return true;
+}
+#else
 google::protobuf::util::Status
 extractLocalNodeMetadata(istio::extension::NodeInfo *node_info) {
   google::protobuf::Struct node;
-  if (!getMessageValue({"node", "metadata"}, &node)) {
+  auto value = Util::readProperty({"node", "metadata"});
+  if (!value || !node.ParseFromArray((*value)->data(), (*value)->size())) {
     return google::protobuf::util::Status(
         google::protobuf::util::error::Code::NOT_FOUND, "metadata not found");
   }
   return extractNodeMetadata(node, node_info);
 }
+#endif
 
 } // namespace
 
@@ -51,10 +70,14 @@ constexpr char DownstreamMetadataKey[] =
     "envoy.wasm.metadata_exchange.downstream";
 
 NodeInfo::NodeInfo() {
+#ifdef ISTIO_WASM_SDK_LITE
+  extractLocalNodeMetadata(&local_node_info_);
+#else
   auto status = extractLocalNodeMetadata(&local_node_info_);
   if (status != google::protobuf::util::Status::OK) {
     LOG_WARN("cannot extract local node metadata: " + status.ToString());
   }
+#endif
 }
 
 const istio::extension::NodeInfo &NodeInfo::getLocalNodeInfo() {
@@ -62,17 +85,41 @@ const istio::extension::NodeInfo &NodeInfo::getLocalNodeInfo() {
 }
 
 const istio::extension::NodeInfo &NodeInfo::getPeerNodeInfo(bool is_outbound) {
-  const auto &id_key =
-      is_outbound ? UpstreamMetadataIdKey : DownstreamMetadataIdKey;
-  const auto &metadata_key =
-      is_outbound ? UpstreamMetadataKey : DownstreamMetadataKey;
-  auto peer = node_info_cache_.getPeerById(id_key, metadata_key);
+  auto peer = getPeerNodeInfoPtr(is_outbound);
   if (!peer) {
     return EmptyNodeInfo;
   }
   return *peer;
 }
 
+void NodeInfo::saveSnapshot(StringView key, StringView version) {
+  std::string snapshot;
+  node_info_cache_.snapshot(version, DefaultNodeCacheSnapshotMaxEntries,
+                            &snapshot);
+  auto result = setSharedData(key, snapshot);
+  if (result != WasmResult::Ok) {
+    LOG_DEBUG("cannot save node info cache snapshot: " + toString(result));
+  }
+}
+
+size_t NodeInfo::restoreSnapshot(StringView key, StringView version) {
+  WasmDataPtr snapshot;
+  if (getSharedData(key, &snapshot) != WasmResult::Ok || !snapshot) {
+    return 0;
+  }
+  return node_info_cache_.restore(
+      snapshot->view(), version,
+      DefaultNodeCacheSnapshotMaxAgeSeconds * 1000000000ull);
+}
+
+NodeInfoPtr NodeInfo::getPeerNodeInfoPtr(bool is_outbound) {
+  const auto &id_key =
+      is_outbound ? UpstreamMetadataIdKey : DownstreamMetadataIdKey;
+  const auto &metadata_key =
+      is_outbound ? UpstreamMetadataKey : DownstreamMetadataKey;
+  return node_info_cache_.getPeerById(id_key, metadata_key);
+}
+
 } // namespace NodeInfo
 } // namespace Extension
 } // namespace Istio
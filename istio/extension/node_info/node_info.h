@@ -13,12 +13,17 @@
  * limitations under the License.
  */
 
+#pragma once
+
 #include "istio/extension/node_info/node_info_cache.h"
 
 namespace Istio {
 namespace Extension {
 namespace NodeInfo {
 
+// Node info returned when peer metadata is not available.
+extern const istio::extension::NodeInfo EmptyNodeInfo;
+
 class NodeInfo {
 public:
   NodeInfo();
@@ -30,6 +35,36 @@ public:
   // Get node metadata of current active stream peer.
   const istio::extension::NodeInfo &getPeerNodeInfo(bool is_outbound);
 
+  // Same as getPeerNodeInfo, but returns a shared pointer which could outlive
+  // the current stream. An empty pointer is returned if peer metadata is not
+  // available.
+  NodeInfoPtr getPeerNodeInfoPtr(bool is_outbound);
+
+  // Configures peer node info cache. A negative max_size disables the cache.
+  void configureCache(int32_t max_size, uint64_t ttl_seconds) {
+    node_info_cache_.setMaxCacheSize(max_size);
+    node_info_cache_.setTtl(ttl_seconds);
+  }
+
+  // Evicts expired peer node info with bounded work.
+  void sweepCache() { node_info_cache_.sweep(); }
+
+  // Peer node info cached under a key other than peer id, see
+  // NodeInfoCache::lookupPeer.
+  NodeInfoPtr lookupPeer(const std::string &key) {
+    return node_info_cache_.lookupPeer(key);
+  }
+  bool insertPeer(std::string key, NodeInfoPtr node_info) {
+    return node_info_cache_.insertPeer(std::move(key), std::move(node_info));
+  }
+
+  // Saves the most used peer node info to shared data under the given key.
+  void saveSnapshot(StringView key, StringView version);
+
+  // Restores peer node info saved by saveSnapshot, possibly by another VM.
+  // Returns the number of restored entries.
+  size_t restoreSnapshot(StringView key, StringView version);
+
 private:
   // Local node info extracted from node metadata.
   istio::extension::NodeInfo local_node_info_;
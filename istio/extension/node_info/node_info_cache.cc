@@ -15,9 +15,18 @@
 
 #include "istio/extension/node_info/node_info_cache.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "istio/extension/util/host_trace.h"
+
+#ifdef ISTIO_WASM_SDK_LITE
+#include "istio/extension/node_info/struct_parser.h"
+#else
 #include "google/protobuf/util/json_util.h"
 
 using google::protobuf::util::Status;
+#endif
 
 namespace Istio {
 namespace Extension {
@@ -25,15 +34,53 @@ namespace NodeInfo {
 
 namespace {
 
+#ifdef ISTIO_WASM_SDK_LITE
+// Like string_value() of a protobuf Value, values of other kinds read as
+// empty.
+std::string stringValue(const StructValue &value) {
+  if (value.kind != StructValue::Kind::String) {
+    return "";
+  }
+  return std::string(value.data.data(), value.data.size());
+}
+
+void extractStringMap(const StructValue &value,
+                      istio::extension::NodeInfo::StringMap *map) {
+  if (value.kind != StructValue::Kind::Struct) {
+    return;
+  }
+  parseStruct(value.data,
+              [map](std::string_view key, const StructValue &map_value) {
+                (*map)[std::string(key)] = stringValue(map_value);
+              });
+}
+
 // getNodeInfo fetches peer node info from host filter state. It returns true if
 // no error occurs.
-bool getNodeInfo(const std::string &peer_metadata_key,
+bool getNodeInfo(StringView peer_metadata_key,
+                 istio::extension::NodeInfo *node_info) {
+  auto metadata = Util::readProperty({"filter_state", peer_metadata_key});
+  if (!metadata) {
+    LOG_DEBUG("cannot get metadata for: " + std::string(peer_metadata_key));
+    return false;
+  }
+  if (!extractNodeMetadata((*metadata)->view(), node_info)) {
+    LOG_DEBUG("cannot parse peer node metadata for: " +
+              std::string(peer_metadata_key));
+    return false;
+  }
+  return true;
+}
+#else
+// getNodeInfo fetches peer node info from host filter state. It returns true if
+// no error occurs.
+bool getNodeInfo(StringView peer_metadata_key,
                  istio::extension::NodeInfo *node_info) {
   google::protobuf::Struct metadata;
-  std::string_view peer_metadata_key_view(peer_metadata_key.data(),
-                                          peer_metadata_key.size());
-  if (!getMessageValue({"filter_state", peer_metadata_key_view}, &metadata)) {
-    LOG_DEBUG("cannot get metadata for: " + peer_metadata_key);
+  auto value = Util::readProperty({"filter_state", peer_metadata_key});
+  if (!value ||
+      !metadata.ParseFromArray((*value)->data(), (*value)->size())) {
+    LOG_DEBUG("cannot get metadata for: " + std::string(peer_metadata_key));
     return false;
   }
 
@@ -45,9 +92,153 @@ bool getNodeInfo(const std::string &peer_metadata_key,
   }
   return true;
 }
+#endif
+
+// Snapshot layout: magic, format version, version given by the caller,
+// creation time and entry count, followed by entries. Integers are varints
+// and strings are length prefixed. An entry is the peer id, its insertion time
+// or 0 if expiry was disabled, the node info string fields in appendNodeInfo
+// order, and then labels and platform metadata, each as a count followed by
+// key value pairs.
+constexpr char kSnapshotMagic[] = "INIC";
+constexpr uint64_t kSnapshotFormatVersion = 2;
+
+struct SnapshotEntry {
+  std::string peer_id;
+  uint64_t inserted_ns;
+  NodeInfoPtr node_info;
+};
+
+void appendVarint(std::string *out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void appendString(std::string *out, StringView value) {
+  appendVarint(out, value.size());
+  out->append(value.data(), value.size());
+}
+
+template <typename Map> void appendMap(std::string *out, const Map &map) {
+  appendVarint(out, map.size());
+  for (const auto &it : map) {
+    appendString(out, it.first);
+    appendString(out, it.second);
+  }
+}
+
+void appendNodeInfo(std::string *out,
+                    const istio::extension::NodeInfo &node_info) {
+  appendString(out, node_info.name());
+  appendString(out, node_info.namespace_());
+  appendString(out, node_info.owner());
+  appendString(out, node_info.workload_name());
+  appendString(out, node_info.istio_version());
+  appendString(out, node_info.mesh_id());
+  appendMap(out, node_info.labels());
+  appendMap(out, node_info.platform_metadata());
+}
+
+class SnapshotReader {
+public:
+  explicit SnapshotReader(StringView data) : data_(data) {}
+
+  bool done() const { return pos_ == data_.size(); }
+
+  bool readVarint(uint64_t *value) {
+    *value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (pos_ == data_.size()) {
+        return false;
+      }
+      uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readString(StringView *value) {
+    uint64_t size = 0;
+    if (!readVarint(&size) || size > data_.size() - pos_) {
+      return false;
+    }
+    *value = data_.substr(pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  template <typename Map> bool readMap(Map *map) {
+    uint64_t count = 0;
+    if (!readVarint(&count)) {
+      return false;
+    }
+    StringView key;
+    StringView value;
+    for (uint64_t i = 0; i < count; i++) {
+      if (!readString(&key) || !readString(&value)) {
+        return false;
+      }
+      (*map)[std::string(key)] = std::string(value);
+    }
+    return true;
+  }
+
+  bool readNodeInfo(istio::extension::NodeInfo *node_info) {
+    StringView name, namespace_, owner, workload_name, istio_version, mesh_id;
+    if (!readString(&name) || !readString(&namespace_) ||
+        !readString(&owner) || !readString(&workload_name) ||
+        !readString(&istio_version) || !readString(&mesh_id)) {
+      return false;
+    }
+    node_info->set_name(std::string(name));
+    node_info->set_namespace_(std::string(namespace_));
+    node_info->set_owner(std::string(owner));
+    node_info->set_workload_name(std::string(workload_name));
+    node_info->set_istio_version(std::string(istio_version));
+    node_info->set_mesh_id(std::string(mesh_id));
+    return readMap(node_info->mutable_labels()) &&
+           readMap(node_info->mutable_platform_metadata());
+  }
+
+private:
+  StringView data_;
+  size_t pos_ = 0;
+};
 
 } // namespace
 
+#ifdef ISTIO_WASM_SDK_LITE
+// Custom-written and lenient struct parser.
+bool extractNodeMetadata(StringView metadata,
+                         istio::extension::NodeInfo *node_info) {
+  return parseStruct(metadata, [node_info](std::string_view key,
+                                           const StructValue &value) {
+    if (key == "NAME") {
+      node_info->set_name(stringValue(value));
+    } else if (key == "NAMESPACE") {
+      node_info->set_namespace_(stringValue(value));
+    } else if (key == "OWNER") {
+      node_info->set_owner(stringValue(value));
+    } else if (key == "WORKLOAD_NAME") {
+      node_info->set_workload_name(stringValue(value));
+    } else if (key == "ISTIO_VERSION") {
+      node_info->set_istio_version(stringValue(value));
+    } else if (key == "MESH_ID") {
+      node_info->set_mesh_id(stringValue(value));
+    } else if (key == "LABELS") {
+      extractStringMap(value, node_info->mutable_labels());
+    } else if (key == "PLATFORM_METADATA") {
+      extractStringMap(value, node_info->mutable_platform_metadata());
+    }
+  });
+}
+#else
 // Custom-written and lenient struct parser.
 google::protobuf::util::Status
 extractNodeMetadata(const google::protobuf::Struct &metadata,
@@ -80,9 +271,23 @@ extractNodeMetadata(const google::protobuf::Struct &metadata,
   }
   return google::protobuf::util::Status::OK;
 }
+#endif
+
+bool parseNodeMetadata(StringView metadata,
+                       istio::extension::NodeInfo *node_info) {
+#ifdef ISTIO_WASM_SDK_LITE
+  return extractNodeMetadata(metadata, node_info);
+#else
+  google::protobuf::Struct metadata_struct;
+  if (!metadata_struct.ParseFromArray(metadata.data(), metadata.size())) {
+    return false;
+  }
+  return extractNodeMetadata(metadata_struct, node_info) == Status::OK;
+#endif
+}
 
-NodeInfoPtr NodeInfoCache::getPeerById(const std::string &peer_metadata_id_key,
-                                       const std::string &peer_metadata_key) {
+NodeInfoPtr NodeInfoCache::getPeerById(StringView peer_metadata_id_key,
+                                       StringView peer_metadata_key) {
   if (max_cache_size_ < 0) {
     // Cache is disabled, fetch node info from host.
     auto node_info_ptr = std::make_shared<istio::extension::NodeInfo>();
@@ -92,28 +297,235 @@ NodeInfoPtr NodeInfoCache::getPeerById(const std::string &peer_metadata_id_key,
     return nullptr;
   }
 
-  std::string peer_id;
-  if (!getValue({"filter_state", peer_metadata_id_key}, &peer_id)) {
-    LOG_DEBUG("cannot get metadata for: " + peer_metadata_id_key);
+  // Peer id is read into a buffer owned by the cache, so that a hit does not
+  // allocate a key.
+  if (!Util::readValue({"filter_state", peer_metadata_id_key}, &peer_id_)) {
+    LOG_DEBUG("cannot get metadata for: " + std::string(peer_metadata_id_key));
     return nullptr;
   }
-  auto nodeinfo_it = cache_.find(peer_id);
-  if (nodeinfo_it != cache_.end()) {
-    return nodeinfo_it->second;
+  uint64_t now = ttl_ns_ != 0 ? getCurrentTimeNanoseconds() : 0;
+  auto nodeinfo_it = cache_.find(peer_id_);
+  bool found = nodeinfo_it != cache_.end();
+  if (found && !expired(nodeinfo_it->second, now)) {
+    nodeinfo_it->second.hits++;
+    return nodeinfo_it->second.node_info;
   }
 
+  auto node_info_ptr = std::make_shared<istio::extension::NodeInfo>();
+  if (!getNodeInfo(peer_metadata_key, node_info_ptr.get())) {
+    return nullptr;
+  }
   // Do not let the cache grow beyond max_cache_size_.
-  if (int32_t(cache_.size()) > max_cache_size_) {
-    auto it = cache_.begin();
-    cache_.erase(cache_.begin(), std::next(it, max_cache_size_ / 4));
-    LOG_INFO("cleaned cache, new cache_size:" + std::to_string(cache_.size()));
+  if (!found && int32_t(cache_.size()) >= max_cache_size_ && !evictOldest()) {
+    return node_info_ptr;
   }
-  auto node_info_ptr = std::make_shared<istio::extension::NodeInfo>();
-  if (getNodeInfo(peer_metadata_key, node_info_ptr.get())) {
-    auto emplacement = cache_.emplace(peer_id, std::move(node_info_ptr));
-    return emplacement.first->second;
+  return insert(peer_id_, std::move(node_info_ptr), now).node_info;
+}
+
+NodeInfoPtr NodeInfoCache::lookupPeer(const std::string &key) {
+  auto it = cache_.find(key);
+  if (it == cache_.end()) {
+    return nullptr;
+  }
+  uint64_t now = ttl_ns_ != 0 ? getCurrentTimeNanoseconds() : 0;
+  if (expired(it->second, now)) {
+    return nullptr;
+  }
+  it->second.hits++;
+  return it->second.node_info;
+}
+
+bool NodeInfoCache::insertPeer(std::string key, NodeInfoPtr node_info) {
+  if (max_cache_size_ < 0 || (int32_t(cache_.size()) >= max_cache_size_ &&
+                              cache_.find(key) == cache_.end() &&
+                              !evictOldest())) {
+    return false;
+  }
+  uint64_t now = ttl_ns_ != 0 ? getCurrentTimeNanoseconds() : 0;
+  insert(std::move(key), std::move(node_info), now);
+  return true;
+}
+
+NodeInfoCache::CacheEntry &
+NodeInfoCache::insert(std::string peer_id, NodeInfoPtr node_info,
+                      uint64_t now) {
+  uint64_t sequence = next_sequence_++;
+  insertion_order_.emplace_back(peer_id, sequence);
+  auto &entry = cache_[std::move(peer_id)];
+  entry.node_info = std::move(node_info);
+  entry.inserted_ns = now;
+  entry.sequence = sequence;
+  if (insertion_order_.size() >
+      2 * cache_.size() + DefaultNodeCacheSweepBatchSize) {
+    compactInsertionOrder();
+  }
+  return entry;
+}
+
+bool NodeInfoCache::evictOldest() {
+  while (!insertion_order_.empty()) {
+    const auto &oldest = insertion_order_.front();
+    auto it = cache_.find(oldest.first);
+    bool live = it != cache_.end() && it->second.sequence == oldest.second;
+    if (live) {
+      cache_.erase(it);
+    }
+    insertion_order_.pop_front();
+    if (live) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void NodeInfoCache::compactInsertionOrder() {
+  // Linear, but runs only after as many insertions as there are live
+  // records, so insertion stays constant time amortized.
+  size_t kept = 0;
+  for (size_t i = 0; i < insertion_order_.size(); i++) {
+    auto &record = insertion_order_[i];
+    auto it = cache_.find(record.first);
+    if (it != cache_.end() && it->second.sequence == record.second) {
+      if (kept != i) {
+        insertion_order_[kept] = std::move(record);
+      }
+      kept++;
+    }
+  }
+  insertion_order_.resize(kept);
+}
+
+void NodeInfoCache::sweep(size_t max_work) {
+  if (insertion_order_.empty()) {
+    return;
+  }
+  uint64_t now = ttl_ns_ != 0 ? getCurrentTimeNanoseconds() : 0;
+  size_t low_watermark = max_cache_size_ < 0 ? 0 : max_cache_size_ * 3 / 4;
+  for (size_t i = 0; i < max_work && !insertion_order_.empty(); i++) {
+    const auto &oldest = insertion_order_.front();
+    auto it = cache_.find(oldest.first);
+    if (it != cache_.end() && it->second.sequence == oldest.second) {
+      if (!expired(it->second, now) && cache_.size() <= low_watermark) {
+        // Everything behind is younger.
+        break;
+      }
+      cache_.erase(it);
+    }
+    insertion_order_.pop_front();
+  }
+}
+
+void NodeInfoCache::snapshot(StringView version, size_t max_entries,
+                             std::string *out) {
+  uint64_t now = getCurrentTimeNanoseconds();
+  std::vector<std::pair<const std::string *, const CacheEntry *>> entries;
+  entries.reserve(cache_.size());
+  for (const auto &it : cache_) {
+    // An expired entry would be fetched again on next lookup anyway.
+    if (!expired(it.second, now)) {
+      entries.emplace_back(&it.first, &it.second);
+    }
+  }
+  max_entries = std::min(max_entries, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + max_entries,
+                    entries.end(), [](const auto &a, const auto &b) {
+                      return a.second->hits > b.second->hits;
+                    });
+
+  out->clear();
+  out->append(kSnapshotMagic);
+  appendVarint(out, kSnapshotFormatVersion);
+  appendString(out, version);
+  appendVarint(out, now);
+  appendVarint(out, max_entries);
+  for (size_t i = 0; i < max_entries; i++) {
+    appendString(out, *entries[i].first);
+    appendVarint(out, entries[i].second->inserted_ns);
+    appendNodeInfo(out, *entries[i].second->node_info);
+  }
+}
+
+size_t NodeInfoCache::restore(StringView snapshot, StringView version,
+                              uint64_t max_age_ns) {
+  if (max_cache_size_ < 0) {
+    return 0;
+  }
+  StringView magic(kSnapshotMagic);
+  if (snapshot.substr(0, magic.size()) != magic) {
+    return 0;
+  }
+  SnapshotReader reader(snapshot.substr(magic.size()));
+  uint64_t format_version = 0;
+  StringView snapshot_version;
+  uint64_t created_ns = 0;
+  if (!reader.readVarint(&format_version) ||
+      format_version != kSnapshotFormatVersion ||
+      !reader.readString(&snapshot_version) || snapshot_version != version ||
+      !reader.readVarint(&created_ns)) {
+    LOG_DEBUG("ignored node info cache snapshot of another version");
+    return 0;
+  }
+  uint64_t now = getCurrentTimeNanoseconds();
+  if (now > created_ns && now - created_ns > max_age_ns) {
+    LOG_DEBUG("ignored stale node info cache snapshot");
+    return 0;
+  }
+
+  // Decode everything before touching the cache, so that a malformed
+  // snapshot is not partially applied. The entry count tells a snapshot
+  // truncated between entries.
+  uint64_t count = 0;
+  std::vector<SnapshotEntry> entries;
+  bool valid = reader.readVarint(&count);
+  for (uint64_t i = 0; valid && i < count; i++) {
+    StringView peer_id;
+    uint64_t inserted_ns = 0;
+    auto node_info = std::make_shared<istio::extension::NodeInfo>();
+    valid = reader.readString(&peer_id) && reader.readVarint(&inserted_ns) &&
+            reader.readNodeInfo(node_info.get());
+    entries.push_back(
+        {std::string(peer_id), inserted_ns, std::move(node_info)});
+  }
+  if (!valid || !reader.done()) {
+    LOG_DEBUG("ignored malformed node info cache snapshot");
+    return 0;
+  }
+
+  // Restored entries keep their insertion time, so that handing the cache
+  // over to a new VM does not extend their TTL. Entries saved with expiry
+  // disabled are stamped with the time of restore. The most used entries,
+  // which come first, are kept if the cache cannot hold them all.
+  size_t selected = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (int32_t(cache_.size() + selected) >= max_cache_size_) {
+      break;
+    }
+    auto &entry = entries[i];
+    if (ttl_ns_ == 0) {
+      entry.inserted_ns = 0;
+    } else if (entry.inserted_ns == 0 || entry.inserted_ns > now) {
+      entry.inserted_ns = now;
+    }
+    if (expired(entry.inserted_ns, now) ||
+        cache_.find(entry.peer_id) != cache_.end()) {
+      continue;
+    }
+    if (i != selected) {
+      entries[selected] = std::move(entry);
+    }
+    selected++;
+  }
+  entries.resize(selected);
+  // Insertion order must follow insertion time, as sweep relies on it.
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const SnapshotEntry &a, const SnapshotEntry &b) {
+                     return a.inserted_ns < b.inserted_ns;
+                   });
+  for (auto &entry : entries) {
+    insert(std::move(entry.peer_id), std::move(entry.node_info),
+           entry.inserted_ns);
   }
-  return nullptr;
+  return selected;
 }
 
 } // namespace NodeInfo
@@ -13,17 +13,31 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include <deque>
 #include <unordered_map>
 
 #include "proxy_wasm_intrinsics.h"
 
+// The lite build, selected with --define=istio_wasm_sdk=lite, replaces the
+// NodeInfo message with a plain struct and decodes peer metadata with a
+// handwritten parser, so that SDK does not depend on protobuf.
+#ifdef ISTIO_WASM_SDK_LITE
+#include "istio/extension/node_info/node_info_lite.h"
+#else
 #include "istio/extension/node_info/node_info.pb.h"
+#endif
 
 namespace Istio {
 namespace Extension {
 namespace NodeInfo {
 
 const size_t DefaultNodeCacheMaxSize = 500;
+const size_t DefaultNodeCacheSnapshotMaxEntries = 100;
+const uint64_t DefaultNodeCacheSnapshotMaxAgeSeconds = 300;
+const uint64_t DefaultNodeCacheTtlSeconds = 600;
+const size_t DefaultNodeCacheSweepBatchSize = 64;
 
 typedef std::shared_ptr<const istio::extension::NodeInfo> NodeInfoPtr;
 
@@ -35,21 +49,106 @@ public:
   // At present this involves de-serializing to google.Protobuf.Struct and
   // then another round trip to NodeInfo. This Should at most hold N entries.
   // Node is owned by the cache. Do not store a reference.
-  NodeInfoPtr getPeerById(const std::string &peer_metadata_id_key,
-                          const std::string &peer_metadata_key);
+  // An expired entry is fetched again. A new peer in a full cache takes the
+  // place of the oldest entry, see evictOldest.
+  NodeInfoPtr getPeerById(StringView peer_metadata_id_key,
+                          StringView peer_metadata_key);
 
   inline void setMaxCacheSize(int32_t size) {
     max_cache_size_ = size == 0 ? DefaultNodeCacheMaxSize : size;
   }
 
+  // Sets how long an entry is served before peer metadata is fetched again,
+  // so that a peer id reused with new metadata is picked up. Zero disables
+  // expiry.
+  inline void setTtl(uint64_t ttl_seconds) {
+    ttl_ns_ = ttl_seconds * 1000000000ull;
+  }
+
+  // Drops expired entries, and the oldest entries once the cache is above
+  // 3/4 of its maximum size. Examines at most max_work entries, so it can run
+  // on every tick without a latency spike.
+  void sweep(size_t max_work = DefaultNodeCacheSweepBatchSize);
+
+  // Gets and adds node info resolved by other means than filter state, e.g.
+  // from a metadata service. Keys must not collide with peer ids. Expiry and
+  // size limit apply as for other entries, and insertPeer returns false if the
+  // cache is disabled.
+  NodeInfoPtr lookupPeer(const std::string &key);
+  bool insertPeer(std::string key, NodeInfoPtr node_info);
+
+  size_t size() const { return cache_.size(); }
+
+  // Serializes at most max_entries of the most used entries which have not
+  // expired, so that a new VM can start with a warm cache. The snapshot
+  // records the given version, the current time, and the insertion time of
+  // every entry.
+  void snapshot(StringView version, size_t max_entries, std::string *out);
+
+  // Adds entries of a snapshot to the cache and returns how many were added.
+  // A snapshot of another version or format, older than max_age_ns, or
+  // malformed is ignored as a whole. Entries keep their insertion time, so
+  // those expired by now are skipped, and restore stops once the cache is
+  // full.
+  size_t restore(StringView snapshot, StringView version, uint64_t max_age_ns);
+
 private:
-  std::unordered_map<std::string, NodeInfoPtr> cache_;
+  struct CacheEntry {
+    NodeInfoPtr node_info;
+    // Number of lookups served, which ranks entries for snapshots.
+    uint64_t hits = 0;
+    uint64_t inserted_ns = 0;
+    // Sequence number of the record of the last insertion.
+    uint64_t sequence = 0;
+  };
+
+  // Inserts or refreshes an entry.
+  CacheEntry &insert(std::string peer_id, NodeInfoPtr node_info, uint64_t now);
+  // Evicts the oldest entry of a full cache, so that the request path can
+  // cache a new peer when ticks are absent or sweep falls behind. Every record
+  // it skips was pushed by an earlier insertion, so it takes constant time
+  // amortized, and at most the capped size of insertion_order_. Returns false
+  // if the cache is empty.
+  bool evictOldest();
+  // Drops records of refreshed or evicted entries, once they make up most of
+  // insertion_order_.
+  void compactInsertionOrder();
+  bool expired(uint64_t inserted_ns, uint64_t now) const {
+    return ttl_ns_ != 0 && now - inserted_ns >= ttl_ns_;
+  }
+  bool expired(const CacheEntry &entry, uint64_t now) const {
+    return expired(entry.inserted_ns, now);
+  }
+
+  std::unordered_map<std::string, CacheEntry> cache_;
+  // Peer ids with their insertion sequence number, oldest first. Since all
+  // entries have the same TTL, this is also expiry order. A refreshed or
+  // evicted entry leaves a record whose sequence number does not match, which
+  // is skipped. It holds at most twice as many records as the cache has
+  // entries, plus DefaultNodeCacheSweepBatchSize.
+  std::deque<std::pair<std::string, uint64_t>> insertion_order_;
+  uint64_t next_sequence_ = 0;
   int32_t max_cache_size_ = DefaultNodeCacheMaxSize;
+  uint64_t ttl_ns_ = DefaultNodeCacheTtlSeconds * 1000000000ull;
+  // Peer id of the last lookup. Its capacity is reused across lookups.
+  std::string peer_id_;
 };
 
+#ifdef ISTIO_WASM_SDK_LITE
+// Extracts node info from a serialized google.protobuf.Struct. Returns false
+// if metadata is malformed.
+bool extractNodeMetadata(StringView metadata,
+                         istio::extension::NodeInfo *node_info);
+#else
 google::protobuf::util::Status
 extractNodeMetadata(const google::protobuf::Struct &metadata,
                     istio::extension::NodeInfo *node_info);
+#endif
+
+// Extracts node info from a serialized google.protobuf.Struct in either
+// build. Returns false if metadata is malformed.
+bool parseNodeMetadata(StringView metadata,
+                       istio::extension::NodeInfo *node_info);
 
 } // namespace NodeInfo
 } // namespace Extension
@@ -0,0 +1,363 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/node_info/node_info_cache.h"
+
+#include "istio/extension/node_info/node_info.h"
+
+#include <string>
+
+#include "google/protobuf/struct.pb.h"
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace NodeInfo {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswers;
+
+constexpr char kPeerIdKey[] = "wasm.downstream_peer_id";
+constexpr char kPeerKey[] = "wasm.downstream_peer";
+
+constexpr uint64_t kSecond = 1000000000ull;
+constexpr uint64_t kStartTime = 1600000000 * kSecond;
+
+std::string filterState(StringView key) {
+  return std::string("filter_state\0", 13) + std::string(key);
+}
+
+class NodeInfoCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    FakeHost::get().reset();
+    FakeHost::get().resetCounters();
+    FakeHost::get().setRootAnswers(&answers_);
+    // Tests of expiry set a TTL along with the fake host clock.
+    cache_.setTtl(0);
+  }
+  void TearDown() override { FakeHost::get().setRootAnswers(nullptr); }
+
+  // Looks up a peer whose filter state carries the given id, and the id with
+  // the suffix as name. Returns its name, or an empty string if it is not
+  // found.
+  std::string getPeer(const std::string &id,
+                      const std::string &name_suffix = "-name") {
+    google::protobuf::Struct metadata;
+    (*metadata.mutable_fields())["NAME"].set_string_value(id + name_suffix);
+    answers_[filterState(kPeerIdKey)] = {true, id};
+    answers_[filterState(kPeerKey)] = {true, metadata.SerializeAsString()};
+    auto node_info = cache_.getPeerById(kPeerIdKey, kPeerKey);
+    return node_info ? node_info->name() : "";
+  }
+
+  static NodeInfoPtr node(const std::string &name) {
+    auto node_info = std::make_shared<istio::extension::NodeInfo>();
+    node_info->set_name(name);
+    return node_info;
+  }
+
+  uint64_t metadataReads() const {
+    return FakeHost::get().counters().peer_metadata_reads;
+  }
+
+  HostAnswers answers_;
+  NodeInfoCache cache_;
+};
+
+TEST_F(NodeInfoCacheTest, CachesPeer) {
+  EXPECT_EQ("a-name", getPeer("a"));
+  EXPECT_EQ("a-name", getPeer("a"));
+  EXPECT_EQ(1, metadataReads());
+  EXPECT_EQ(1, cache_.size());
+}
+
+TEST_F(NodeInfoCacheTest, FullCacheEvictsOldestForNewPeer) {
+  cache_.setMaxCacheSize(2);
+  getPeer("a");
+  getPeer("b");
+  // Without a sweep, c takes the place of a.
+  EXPECT_EQ("c-name", getPeer("c"));
+  EXPECT_EQ(2, cache_.size());
+  EXPECT_EQ(3, metadataReads());
+
+  getPeer("c");
+  getPeer("b");
+  EXPECT_EQ(3, metadataReads());
+  EXPECT_EQ("a-name", getPeer("a"));
+  EXPECT_EQ(4, metadataReads());
+}
+
+TEST_F(NodeInfoCacheTest, EvictionSkipsRefreshedEntries) {
+  cache_.setMaxCacheSize(2);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  // Refreshing a makes b the oldest entry, although expiry is disabled and
+  // every entry has the same insertion time.
+  ASSERT_TRUE(cache_.insertPeer("a", node("a2")));
+  ASSERT_TRUE(cache_.insertPeer("c", node("c")));
+
+  EXPECT_EQ(2, cache_.size());
+  ASSERT_NE(nullptr, cache_.lookupPeer("a"));
+  EXPECT_EQ("a2", cache_.lookupPeer("a")->name());
+  EXPECT_EQ(nullptr, cache_.lookupPeer("b"));
+  EXPECT_NE(nullptr, cache_.lookupPeer("c"));
+}
+
+TEST_F(NodeInfoCacheTest, RepeatedRefreshesKeepEvictionOrder) {
+  cache_.setMaxCacheSize(3);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  // Enough refreshes to compact stale records several times.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  }
+  ASSERT_TRUE(cache_.insertPeer("c", node("c")));
+  ASSERT_TRUE(cache_.insertPeer("d", node("d")));
+  ASSERT_TRUE(cache_.insertPeer("e", node("e")));
+
+  EXPECT_EQ(3, cache_.size());
+  EXPECT_EQ(nullptr, cache_.lookupPeer("a"));
+  EXPECT_EQ(nullptr, cache_.lookupPeer("b"));
+  EXPECT_NE(nullptr, cache_.lookupPeer("c"));
+  EXPECT_NE(nullptr, cache_.lookupPeer("d"));
+  EXPECT_NE(nullptr, cache_.lookupPeer("e"));
+}
+
+TEST_F(NodeInfoCacheTest, SweepShrinksFullCache) {
+  cache_.setMaxCacheSize(4);
+  for (const char *id : {"a", "b", "c", "d"}) {
+    ASSERT_TRUE(cache_.insertPeer(id, node(id)));
+  }
+  cache_.sweep();
+  EXPECT_EQ(3, cache_.size());
+  EXPECT_EQ(nullptr, cache_.lookupPeer("a"));
+}
+
+TEST_F(NodeInfoCacheTest, RefetchesExpiredPeer) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  EXPECT_EQ("a-name", getPeer("a"));
+  FakeHost::get().advanceTime(59 * kSecond);
+  EXPECT_EQ("a-name", getPeer("a", "-new"));
+  EXPECT_EQ(1, metadataReads());
+
+  // The id is reused by a peer with new metadata, which is picked up once the
+  // entry expires.
+  FakeHost::get().advanceTime(kSecond);
+  EXPECT_EQ("a-new", getPeer("a", "-new"));
+  EXPECT_EQ(2, metadataReads());
+  EXPECT_EQ(1, cache_.size());
+  EXPECT_EQ("a-new", getPeer("a", "-new"));
+  EXPECT_EQ(2, metadataReads());
+}
+
+TEST_F(NodeInfoCacheTest, LookupMissesAfterTtl) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  FakeHost::get().advanceTime(60 * kSecond - 1);
+  EXPECT_NE(nullptr, cache_.lookupPeer("a"));
+  FakeHost::get().advanceTime(1);
+  EXPECT_EQ(nullptr, cache_.lookupPeer("a"));
+}
+
+TEST_F(NodeInfoCacheTest, SweepDropsExpiredEntries) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  FakeHost::get().advanceTime(30 * kSecond);
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  FakeHost::get().advanceTime(20 * kSecond);
+  ASSERT_TRUE(cache_.insertPeer("c", node("c")));
+
+  // Only a has expired. Sweep stops at b, the oldest live entry, since the
+  // cache is below its low watermark.
+  FakeHost::get().advanceTime(20 * kSecond);
+  cache_.sweep();
+  EXPECT_EQ(2, cache_.size());
+  EXPECT_EQ(nullptr, cache_.lookupPeer("a"));
+
+  FakeHost::get().advanceTime(25 * kSecond);
+  cache_.sweep();
+  EXPECT_EQ(1, cache_.size());
+  EXPECT_NE(nullptr, cache_.lookupPeer("c"));
+}
+
+TEST_F(NodeInfoCacheTest, SweepIsBounded) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(cache_.insertPeer(std::to_string(i), node("n")));
+  }
+  FakeHost::get().advanceTime(60 * kSecond);
+  cache_.sweep(4);
+  EXPECT_EQ(6, cache_.size());
+  cache_.sweep();
+  EXPECT_EQ(0, cache_.size());
+}
+
+TEST_F(NodeInfoCacheTest, SnapshotRoundTrip) {
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  NodeInfo source;
+  source.configureCache(10, 600);
+  auto node_info = std::make_shared<istio::extension::NodeInfo>();
+  node_info->set_name("a");
+  node_info->set_namespace_("default");
+  node_info->set_workload_name("reviews-v1");
+  (*node_info->mutable_labels())["app"] = "reviews";
+  (*node_info->mutable_platform_metadata())["gcp_project"] = "p";
+  ASSERT_TRUE(source.insertPeer("a", node_info));
+  ASSERT_TRUE(source.insertPeer("b", node("b")));
+  source.saveSnapshot("snapshot", "v1");
+
+  NodeInfo target;
+  target.configureCache(10, 600);
+  EXPECT_EQ(2, target.restoreSnapshot("snapshot", "v1"));
+  auto restored = target.lookupPeer("a");
+  ASSERT_NE(nullptr, restored);
+  EXPECT_EQ("a", restored->name());
+  EXPECT_EQ("default", restored->namespace_());
+  EXPECT_EQ("reviews-v1", restored->workload_name());
+  EXPECT_EQ("reviews", restored->labels().at("app"));
+  EXPECT_EQ("p", restored->platform_metadata().at("gcp_project"));
+  EXPECT_NE(nullptr, target.lookupPeer("b"));
+
+  // Entries already cached are kept.
+  EXPECT_EQ(0, target.restoreSnapshot("snapshot", "v1"));
+}
+
+TEST_F(NodeInfoCacheTest, SnapshotKeepsInsertionTime) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  FakeHost::get().advanceTime(30 * kSecond);
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  FakeHost::get().advanceTime(40 * kSecond);
+  // a has expired, and is left out.
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  NodeInfoCache restored;
+  restored.setTtl(60);
+  EXPECT_EQ(1, restored.restore(snapshot, "v1", 300 * kSecond));
+  EXPECT_EQ(nullptr, restored.lookupPeer("a"));
+  EXPECT_NE(nullptr, restored.lookupPeer("b"));
+  // b expires 60s after it was fetched, not after it was restored.
+  FakeHost::get().advanceTime(20 * kSecond);
+  EXPECT_EQ(nullptr, restored.lookupPeer("b"));
+  restored.sweep();
+  EXPECT_EQ(0, restored.size());
+}
+
+TEST_F(NodeInfoCacheTest, RestoreSkipsEntriesExpiredSinceSnapshot) {
+  cache_.setTtl(60);
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  FakeHost::get().advanceTime(30 * kSecond);
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  FakeHost::get().advanceTime(30 * kSecond);
+  NodeInfoCache restored;
+  restored.setTtl(60);
+  EXPECT_EQ(1, restored.restore(snapshot, "v1", 300 * kSecond));
+  EXPECT_NE(nullptr, restored.lookupPeer("b"));
+}
+
+TEST_F(NodeInfoCacheTest, IgnoresSnapshotOfAnotherVersion) {
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  NodeInfoCache restored;
+  EXPECT_EQ(0, restored.restore(snapshot, "v2", 300 * kSecond));
+  EXPECT_EQ(0, restored.size());
+}
+
+TEST_F(NodeInfoCacheTest, IgnoresStaleSnapshot) {
+  FakeHost::get().setCurrentTimeNanoseconds(kStartTime);
+  ASSERT_TRUE(cache_.insertPeer("a", node("a")));
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  FakeHost::get().advanceTime(301 * kSecond);
+  NodeInfoCache restored;
+  EXPECT_EQ(0, restored.restore(snapshot, "v1", 300 * kSecond));
+  EXPECT_EQ(0, restored.size());
+}
+
+TEST_F(NodeInfoCacheTest, IgnoresMalformedSnapshot) {
+  auto node_info = std::make_shared<istio::extension::NodeInfo>();
+  node_info->set_name("a");
+  (*node_info->mutable_labels())["app"] = "reviews";
+  ASSERT_TRUE(cache_.insertPeer("a", node_info));
+  ASSERT_TRUE(cache_.insertPeer("b", node("b")));
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  // A truncated snapshot is not partially applied, wherever it ends.
+  for (size_t size = 0; size < snapshot.size(); size++) {
+    NodeInfoCache restored;
+    EXPECT_EQ(0, restored.restore(StringView(snapshot.data(), size), "v1",
+                                  300 * kSecond));
+    EXPECT_EQ(0, restored.size());
+  }
+
+  // Nor is one whose last map claims more pairs than there are.
+  snapshot.back() = '\x7f';
+  NodeInfoCache restored;
+  EXPECT_EQ(0, restored.restore(snapshot, "v1", 300 * kSecond));
+  EXPECT_EQ(0, restored.size());
+}
+
+TEST_F(NodeInfoCacheTest, RestoreStopsAtMaxSize) {
+  for (const char *id : {"a", "b", "c", "d"}) {
+    ASSERT_TRUE(cache_.insertPeer(id, node(id)));
+  }
+  // c and a are the most used.
+  for (int i = 0; i < 3; i++) {
+    cache_.lookupPeer("c");
+  }
+  cache_.lookupPeer("a");
+  cache_.lookupPeer("a");
+  cache_.lookupPeer("d");
+  std::string snapshot;
+  cache_.snapshot("v1", 10, &snapshot);
+
+  NodeInfoCache restored;
+  restored.setMaxCacheSize(2);
+  EXPECT_EQ(2, restored.restore(snapshot, "v1", 300 * kSecond));
+  EXPECT_EQ(2, restored.size());
+  EXPECT_NE(nullptr, restored.lookupPeer("c"));
+  EXPECT_NE(nullptr, restored.lookupPeer("a"));
+}
+
+TEST_F(NodeInfoCacheTest, DisabledCacheFetchesEveryTime) {
+  cache_.setMaxCacheSize(-1);
+  EXPECT_EQ("a-name", getPeer("a"));
+  EXPECT_EQ("a-name", getPeer("a"));
+  EXPECT_EQ(2, metadataReads());
+  EXPECT_FALSE(cache_.insertPeer("a", node("a")));
+  EXPECT_EQ(0, cache_.size());
+}
+
+} // namespace
+} // namespace NodeInfo
+} // namespace Extension
+} // namespace Istio
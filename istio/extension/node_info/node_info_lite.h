@@ -0,0 +1,72 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace istio {
+namespace extension {
+
+// Plain C++ replacement of the NodeInfo message in node_info.proto, used by
+// the lite build. It mirrors the accessors protoc generates for the fields
+// SDK uses, so that code compiles against either.
+class NodeInfo {
+public:
+  typedef std::map<std::string, std::string> StringMap;
+
+  const std::string &name() const { return name_; }
+  void set_name(std::string value) { name_ = std::move(value); }
+
+  const std::string &namespace_() const { return namespace__; }
+  void set_namespace_(std::string value) { namespace__ = std::move(value); }
+
+  const std::string &owner() const { return owner_; }
+  void set_owner(std::string value) { owner_ = std::move(value); }
+
+  const std::string &workload_name() const { return workload_name_; }
+  void set_workload_name(std::string value) {
+    workload_name_ = std::move(value);
+  }
+
+  const std::string &istio_version() const { return istio_version_; }
+  void set_istio_version(std::string value) {
+    istio_version_ = std::move(value);
+  }
+
+  const std::string &mesh_id() const { return mesh_id_; }
+  void set_mesh_id(std::string value) { mesh_id_ = std::move(value); }
+
+  const StringMap &labels() const { return labels_; }
+  StringMap *mutable_labels() { return &labels_; }
+
+  const StringMap &platform_metadata() const { return platform_metadata_; }
+  StringMap *mutable_platform_metadata() { return &platform_metadata_; }
+
+private:
+  std::string name_;
+  std::string namespace__;
+  std::string owner_;
+  std::string workload_name_;
+  std::string istio_version_;
+  std::string mesh_id_;
+  StringMap labels_;
+  StringMap platform_metadata_;
+};
+
+} // namespace extension
+} // namespace istio
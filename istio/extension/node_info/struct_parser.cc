@@ -0,0 +1,190 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/node_info/struct_parser.h"
+
+#include <cstdint>
+
+namespace Istio {
+namespace Extension {
+namespace NodeInfo {
+
+namespace {
+
+enum WireType : uint32_t {
+  Varint = 0,
+  Fixed64 = 1,
+  LengthDelimited = 2,
+  Fixed32 = 5,
+};
+
+// Field numbers of google.protobuf.Struct, its map entry and
+// google.protobuf.Value.
+constexpr uint32_t kStructFields = 1;
+constexpr uint32_t kEntryKey = 1;
+constexpr uint32_t kEntryValue = 2;
+constexpr uint32_t kValueString = 3;
+constexpr uint32_t kValueStruct = 5;
+
+class WireReader {
+public:
+  explicit WireReader(std::string_view data) : data_(data) {}
+
+  bool done() const { return pos_ == data_.size(); }
+
+  bool readVarint(uint64_t *value) {
+    *value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (pos_ == data_.size()) {
+        return false;
+      }
+      uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readTag(uint32_t *field, uint32_t *wire_type) {
+    uint64_t tag = 0;
+    if (!readVarint(&tag)) {
+      return false;
+    }
+    *field = static_cast<uint32_t>(tag >> 3);
+    *wire_type = static_cast<uint32_t>(tag & 0x7);
+    return *field != 0;
+  }
+
+  bool readBytes(std::string_view *bytes) {
+    uint64_t size = 0;
+    if (!readVarint(&size) || size > data_.size() - pos_) {
+      return false;
+    }
+    *bytes = data_.substr(pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool skip(uint32_t wire_type) {
+    uint64_t value = 0;
+    std::string_view bytes;
+    switch (wire_type) {
+    case Varint:
+      return readVarint(&value);
+    case Fixed64:
+      return advance(8);
+    case LengthDelimited:
+      return readBytes(&bytes);
+    case Fixed32:
+      return advance(4);
+    default:
+      // Groups are not used by Struct.
+      return false;
+    }
+  }
+
+private:
+  bool advance(size_t size) {
+    if (size > data_.size() - pos_) {
+      return false;
+    }
+    pos_ += size;
+    return true;
+  }
+
+  std::string_view data_;
+  size_t pos_ = 0;
+};
+
+bool parseValue(std::string_view data, StructValue *value) {
+  WireReader reader(data);
+  uint32_t field = 0;
+  uint32_t wire_type = 0;
+  while (!reader.done()) {
+    if (!reader.readTag(&field, &wire_type)) {
+      return false;
+    }
+    if ((field == kValueString || field == kValueStruct) &&
+        wire_type == LengthDelimited) {
+      if (!reader.readBytes(&value->data)) {
+        return false;
+      }
+      value->kind = field == kValueString ? StructValue::Kind::String
+                                          : StructValue::Kind::Struct;
+    } else if (!reader.skip(wire_type)) {
+      return false;
+    } else {
+      // Value is a oneof, so the last kind on the wire wins.
+      value->kind = StructValue::Kind::Other;
+      value->data = std::string_view();
+    }
+  }
+  return true;
+}
+
+bool parseEntry(std::string_view data, const StructFieldCallback &on_field) {
+  WireReader reader(data);
+  std::string_view key;
+  StructValue value;
+  uint32_t field = 0;
+  uint32_t wire_type = 0;
+  while (!reader.done()) {
+    if (!reader.readTag(&field, &wire_type)) {
+      return false;
+    }
+    std::string_view bytes;
+    if (field == kEntryKey && wire_type == LengthDelimited) {
+      if (!reader.readBytes(&key)) {
+        return false;
+      }
+    } else if (field == kEntryValue && wire_type == LengthDelimited) {
+      if (!reader.readBytes(&bytes) || !parseValue(bytes, &value)) {
+        return false;
+      }
+    } else if (!reader.skip(wire_type)) {
+      return false;
+    }
+  }
+  on_field(key, value);
+  return true;
+}
+
+} // namespace
+
+bool parseStruct(std::string_view data, const StructFieldCallback &on_field) {
+  WireReader reader(data);
+  uint32_t field = 0;
+  uint32_t wire_type = 0;
+  while (!reader.done()) {
+    if (!reader.readTag(&field, &wire_type)) {
+      return false;
+    }
+    if (field == kStructFields && wire_type == LengthDelimited) {
+      std::string_view entry;
+      if (!reader.readBytes(&entry) || !parseEntry(entry, on_field)) {
+        return false;
+      }
+    } else if (!reader.skip(wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace NodeInfo
+} // namespace Extension
+} // namespace Istio
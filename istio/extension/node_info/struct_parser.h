@@ -0,0 +1,46 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+namespace Istio {
+namespace Extension {
+namespace NodeInfo {
+
+// Value of a google.protobuf.Struct field. Only string and struct values are
+// decoded, which is all node metadata uses. Other kinds are reported as Other.
+struct StructValue {
+  enum class Kind { Other, String, Struct };
+
+  Kind kind = Kind::Other;
+  // String value, or serialized nested struct.
+  std::string_view data;
+};
+
+typedef std::function<void(std::string_view key, const StructValue &value)>
+    StructFieldCallback;
+
+// Iterates fields of a serialized google.protobuf.Struct, reading the wire
+// format directly rather than through protobuf. Views passed to the callback
+// point into data. Returns false if data is malformed, in which case fields
+// before the malformed one have been reported already.
+bool parseStruct(std::string_view data, const StructFieldCallback &on_field);
+
+} // namespace NodeInfo
+} // namespace Extension
+} // namespace Istio
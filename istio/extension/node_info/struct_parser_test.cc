@@ -0,0 +1,190 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/node_info/struct_parser.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/struct.pb.h"
+#include "gtest/gtest.h"
+
+namespace Istio {
+namespace Extension {
+namespace NodeInfo {
+namespace {
+
+struct Field {
+  std::string key;
+  StructValue::Kind kind;
+  std::string data;
+};
+
+// Parses data, copying out the reported fields.
+bool parse(const std::string &data, std::vector<Field> *fields) {
+  return parseStruct(data, [fields](std::string_view key,
+                                    const StructValue &value) {
+    fields->push_back(
+        {std::string(key), value.kind, std::string(value.data)});
+  });
+}
+
+std::string serialize(const google::protobuf::Struct &message) {
+  std::string out;
+  message.SerializeToString(&out);
+  return out;
+}
+
+TEST(StructParserTest, EmptyStruct) {
+  std::vector<Field> fields;
+  EXPECT_TRUE(parse("", &fields));
+  EXPECT_TRUE(fields.empty());
+}
+
+TEST(StructParserTest, StringValue) {
+  google::protobuf::Struct message;
+  (*message.mutable_fields())["NAMESPACE"].set_string_value("default");
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(serialize(message), &fields));
+  ASSERT_EQ(1, fields.size());
+  EXPECT_EQ("NAMESPACE", fields[0].key);
+  EXPECT_EQ(StructValue::Kind::String, fields[0].kind);
+  EXPECT_EQ("default", fields[0].data);
+}
+
+TEST(StructParserTest, EmptyStringValue) {
+  google::protobuf::Struct message;
+  (*message.mutable_fields())["NAME"].set_string_value("");
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(serialize(message), &fields));
+  ASSERT_EQ(1, fields.size());
+  EXPECT_EQ("NAME", fields[0].key);
+  EXPECT_EQ(StructValue::Kind::String, fields[0].kind);
+  EXPECT_EQ("", fields[0].data);
+}
+
+TEST(StructParserTest, NestedStruct) {
+  google::protobuf::Struct labels;
+  (*labels.mutable_fields())["app"].set_string_value("reviews");
+  (*labels.mutable_fields())["version"].set_string_value("v1");
+  google::protobuf::Struct message;
+  *(*message.mutable_fields())["LABELS"].mutable_struct_value() = labels;
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(serialize(message), &fields));
+  ASSERT_EQ(1, fields.size());
+  EXPECT_EQ("LABELS", fields[0].key);
+  ASSERT_EQ(StructValue::Kind::Struct, fields[0].kind);
+
+  std::vector<Field> nested;
+  ASSERT_TRUE(parse(fields[0].data, &nested));
+  ASSERT_EQ(2, nested.size());
+  for (const auto &field : nested) {
+    EXPECT_EQ(StructValue::Kind::String, field.kind);
+    EXPECT_EQ(labels.fields().at(field.key).string_value(), field.data);
+  }
+}
+
+TEST(StructParserTest, OtherKinds) {
+  google::protobuf::Struct message;
+  (*message.mutable_fields())["number"].set_number_value(8.5);
+  (*message.mutable_fields())["bool"].set_bool_value(true);
+  (*message.mutable_fields())["null"].set_null_value(
+      google::protobuf::NULL_VALUE);
+  (*message.mutable_fields())["list"]
+      .mutable_list_value()
+      ->add_values()
+      ->set_string_value("a");
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(serialize(message), &fields));
+  ASSERT_EQ(4, fields.size());
+  for (const auto &field : fields) {
+    EXPECT_EQ(StructValue::Kind::Other, field.kind) << field.key;
+    EXPECT_EQ("", field.data) << field.key;
+  }
+}
+
+TEST(StructParserTest, LastKindOnTheWireWins) {
+  // Value {string_value: "a", number_value: 1}, as a concatenation of two
+  // serialized values would produce.
+  const std::string value = std::string("\x1a\x01" "a", 3) +
+                            std::string("\x11\0\0\0\0\0\0\xf0\x3f", 9);
+  const std::string entry = std::string("\x0a\x01" "k\x12", 4) +
+                            char(value.size()) + value;
+  const std::string data = std::string("\x0a", 1) + char(entry.size()) + entry;
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(data, &fields));
+  ASSERT_EQ(1, fields.size());
+  EXPECT_EQ(StructValue::Kind::Other, fields[0].kind);
+}
+
+TEST(StructParserTest, SkipsUnknownFields) {
+  google::protobuf::Struct message;
+  (*message.mutable_fields())["NAME"].set_string_value("reviews-v1");
+  // Unknown varint, fixed64, length delimited and fixed32 fields of Struct.
+  const std::string unknown = std::string("\x10\x96\x01", 3) +
+                              std::string("\x19" "12345678", 9) +
+                              std::string("\x22\x02" "ab", 4) +
+                              std::string("\x2d" "1234", 5);
+
+  std::vector<Field> fields;
+  ASSERT_TRUE(parse(unknown + serialize(message) + unknown, &fields));
+  ASSERT_EQ(1, fields.size());
+  EXPECT_EQ("NAME", fields[0].key);
+  EXPECT_EQ("reviews-v1", fields[0].data);
+}
+
+TEST(StructParserTest, ReportsFieldsBeforeMalformedOne) {
+  google::protobuf::Struct message;
+  (*message.mutable_fields())["NAME"].set_string_value("reviews-v1");
+  const std::string data = serialize(message);
+
+  // Truncated field, length beyond the end, zero field number and a group.
+  for (const std::string &malformed :
+       {data.substr(0, data.size() - 1), std::string("\x0a\x05" "ab", 4),
+        std::string("\x02\x00", 2), std::string("\x0b", 1),
+        std::string("\x08\x80", 2)}) {
+    std::vector<Field> fields;
+    EXPECT_FALSE(parse(data + malformed, &fields));
+    ASSERT_EQ(1, fields.size());
+    EXPECT_EQ("NAME", fields[0].key);
+    EXPECT_EQ("reviews-v1", fields[0].data);
+  }
+}
+
+TEST(StructParserTest, RejectsMalformedValue) {
+  // Entry {key: "k", value: <string_value longer than the value>}.
+  const std::string data("\x0a\x07\x0a\x01k\x12\x02\x1a\x05", 9);
+
+  std::vector<Field> fields;
+  EXPECT_FALSE(parse(data, &fields));
+  EXPECT_TRUE(fields.empty());
+}
+
+TEST(StructParserTest, RejectsOverlongVarint) {
+  std::vector<Field> fields;
+  EXPECT_FALSE(parse(std::string(11, '\xff'), &fields));
+  EXPECT_TRUE(fields.empty());
+}
+
+} // namespace
+} // namespace NodeInfo
+} // namespace Extension
+} // namespace Istio
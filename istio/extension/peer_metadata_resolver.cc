@@ -0,0 +1,148 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/peer_metadata_resolver.h"
+
+#include <algorithm>
+
+namespace Istio {
+namespace Extension {
+
+namespace {
+
+const char kPeerCacheKeyPrefix[] = "address:";
+
+} // namespace
+
+std::string PeerMetadataResolver::cacheKey(StringView address) {
+  return std::string(kPeerCacheKeyPrefix).append(address.data(),
+                                                  address.size());
+}
+
+NodeInfo::NodeInfoPtr PeerMetadataResolver::lookup(StringView address) {
+  if (!enabled() || address.empty()) {
+    return nullptr;
+  }
+  return node_info_->lookupPeer(cacheKey(address));
+}
+
+bool PeerMetadataResolver::resolve(StringView address, uint32_t context_id,
+                                   PeerMetadataWaiter *waiter) {
+  if (!enabled() || address.empty() || lookup(address)) {
+    return true;
+  }
+  std::string key(address.data(), address.size());
+  auto waiting = waiters_.find(key);
+  if (waiting != waiters_.end()) {
+    waiting->second.push_back({context_id, waiter});
+    return false;
+  }
+  auto failed = failed_.find(key);
+  if (failed != failed_.end()) {
+    if (getCurrentTimeNanoseconds() < failed->second) {
+      return true;
+    }
+    failed_.erase(failed);
+  }
+  if (waiters_.size() >= config_.max_in_flight) {
+    return true;
+  }
+
+  HeaderStringPairs headers{
+      {":method", "GET"},
+      {":path", config_.path + "?address=" + key},
+      {":authority", config_.authority},
+  };
+  auto result = root_->httpCall(
+      config_.cluster, headers, {}, {}, config_.timeout_ms,
+      [this, key](uint32_t, size_t body_size, uint32_t) {
+        onResponse(key, body_size);
+      });
+  if (result != WasmResult::Ok) {
+    LOG_DEBUG("cannot resolve peer metadata from " + config_.cluster + ": " +
+              toString(result));
+    fail(key);
+    return true;
+  }
+  waiters_[key].push_back({context_id, waiter});
+  return false;
+}
+
+void PeerMetadataResolver::cancel(StringView address,
+                                  PeerMetadataWaiter *waiter) {
+  auto waiting = waiters_.find(std::string(address.data(), address.size()));
+  if (waiting == waiters_.end()) {
+    return;
+  }
+  auto &waiters = waiting->second;
+  waiters.erase(std::remove_if(waiters.begin(), waiters.end(),
+                               [waiter](const Waiter &w) {
+                                 return w.waiter == waiter;
+                               }),
+                waiters.end());
+}
+
+void PeerMetadataResolver::onTick() {
+  if (failed_.empty()) {
+    return;
+  }
+  uint64_t now = getCurrentTimeNanoseconds();
+  for (auto it = failed_.begin(); it != failed_.end();) {
+    it = now >= it->second ? failed_.erase(it) : std::next(it);
+  }
+}
+
+void PeerMetadataResolver::onResponse(const std::string &address,
+                                      size_t body_size) {
+  auto status =
+      getHeaderMapValue(HeaderMapType::HttpCallResponseHeaders, ":status");
+  NodeInfo::NodeInfoPtr resolved;
+  if (status && status->view() == "200") {
+    auto body = getBufferBytes(BufferType::HttpCallResponseBody, 0, body_size);
+    auto node_info = std::make_shared<istio::extension::NodeInfo>();
+    if (body && NodeInfo::parseNodeMetadata(body->view(), node_info.get())) {
+      resolved = std::move(node_info);
+    }
+  }
+  if (!resolved) {
+    // Unknown peer, failed call or timeout.
+    fail(address);
+  } else if (!node_info_->insertPeer(cacheKey(address), resolved)) {
+    // Cache is disabled. Back off as after a failure rather than have the
+    // next stream of this peer call the service again.
+    fail(address);
+  }
+
+  auto waiting = waiters_.find(address);
+  if (waiting == waiters_.end()) {
+    return;
+  }
+  auto waiters = std::move(waiting->second);
+  waiters_.erase(waiting);
+  for (const auto &waiter : waiters) {
+    if (proxy_set_effective_context(waiter.context_id) == WasmResult::Ok) {
+      waiter.waiter->onPeerResolved(resolved);
+    }
+  }
+  proxy_set_effective_context(root_->id());
+}
+
+void PeerMetadataResolver::fail(const std::string &address) {
+  failed_[address] =
+      getCurrentTimeNanoseconds() + config_.retry_seconds * 1000000000ull;
+}
+
+} // namespace Extension
+} // namespace Istio
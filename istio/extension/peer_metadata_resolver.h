@@ -0,0 +1,117 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "istio/extension/node_info/node_info.h"
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+
+struct PeerMetadataServiceConfig {
+  // Upstream cluster of the metadata service. Empty disables resolution.
+  std::string cluster;
+  std::string authority = "metadata";
+  // Request path. The peer address is passed as the address query parameter.
+  std::string path = "/v1/peer";
+  uint32_t timeout_ms = 1000;
+
+  // A peer which could not be resolved is not looked up again for this long,
+  // and its streams continue right away with empty node info.
+  uint64_t retry_seconds = 30;
+  // Maximum number of peers resolved at a time. Streams of further peers
+  // continue without waiting.
+  size_t max_in_flight = 64;
+};
+
+// Stream waiting for its peer to be resolved.
+class PeerMetadataWaiter {
+public:
+  virtual ~PeerMetadataWaiter() = default;
+
+  // Called with the stream as effective context once the call for its peer
+  // completes or times out. node_info is null if the peer is not resolved.
+  // The stream should continue from here.
+  virtual void onPeerResolved(NodeInfo::NodeInfoPtr node_info) = 0;
+};
+
+// PeerMetadataResolver resolves node info of peers which did not exchange
+// metadata, e.g. plain text clients outside of the mesh, from a metadata
+// service keyed by peer address. The service answers GET <path>?address=<ip>
+// with a serialized google.protobuf.Struct of node metadata, or 404.
+//
+// Lookups are single flight: streams from the same peer which arrive while a
+// call is in flight wait for that call instead of starting another. Resolved
+// node info is handed to the waiting streams, and goes to the node info cache,
+// so it expires and is snapshotted with the rest of the cache. If the cache is
+// disabled, the peer is not looked up again for retry_seconds, as after a
+// failure. The resolver is owned by a root context, and waiting streams are
+// notified from the http call callback.
+class PeerMetadataResolver {
+public:
+  PeerMetadataResolver(RootContext *root, NodeInfo::NodeInfo *node_info)
+      : root_(root), node_info_(node_info) {}
+
+  void configure(PeerMetadataServiceConfig config) {
+    config_ = std::move(config);
+  }
+  bool enabled() const { return !config_.cluster.empty(); }
+
+  // Gets resolved node info of the peer at address, or null.
+  NodeInfo::NodeInfoPtr lookup(StringView address);
+
+  // Starts resolving the peer at address for the stream context_id, or joins
+  // a call already in flight. Returns true if the stream can go on, i.e. the
+  // peer is resolved already, has failed recently or no call could be made.
+  // Otherwise the stream should stop iteration, and waiter is notified once
+  // the call completes or times out.
+  bool resolve(StringView address, uint32_t context_id,
+               PeerMetadataWaiter *waiter);
+
+  // Stops waiting for the peer at address on behalf of a stream which is
+  // destroyed before the call completes.
+  void cancel(StringView address, PeerMetadataWaiter *waiter);
+
+  // Drops expired failures. Should be called from root context onTick.
+  void onTick();
+
+  size_t inFlight() const { return waiters_.size(); }
+
+private:
+  void onResponse(const std::string &address, size_t body_size);
+  void fail(const std::string &address);
+  static std::string cacheKey(StringView address);
+
+  RootContext *root_;
+  NodeInfo::NodeInfo *node_info_;
+  PeerMetadataServiceConfig config_;
+
+  struct Waiter {
+    uint32_t context_id;
+    PeerMetadataWaiter *waiter;
+  };
+  // Streams waiting for each peer address with a call in flight.
+  std::unordered_map<std::string, std::vector<Waiter>> waiters_;
+  // Time after which each recently failed peer address may be tried again.
+  std::unordered_map<std::string, uint64_t> failed_;
+};
+
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,156 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/peer_metadata_resolver.h"
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/struct.pb.h"
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+
+namespace Istio {
+namespace Extension {
+namespace {
+
+using Replay::FakeHost;
+using Replay::HostAnswers;
+
+class TestWaiter : public PeerMetadataWaiter {
+public:
+  void onPeerResolved(NodeInfo::NodeInfoPtr node_info) override {
+    calls++;
+    resolved = std::move(node_info);
+  }
+
+  int calls = 0;
+  NodeInfo::NodeInfoPtr resolved;
+};
+
+class PeerMetadataResolverTest : public testing::Test {
+protected:
+  void SetUp() override {
+    FakeHost::get().reset();
+    FakeHost::get().acceptHttpCalls(true);
+    FakeHost::get().setRootAnswers(&answers_);
+    PeerMetadataServiceConfig config;
+    config.cluster = "metadata";
+    resolver_.configure(config);
+  }
+
+  void TearDown() override {
+    FakeHost::get().setRootAnswers(nullptr);
+    FakeHost::get().reset();
+  }
+
+  // Answers the last http call with status, and with node metadata named
+  // name if status is 200.
+  void respond(const std::string &status, const std::string &name = "") {
+    ASSERT_FALSE(calls().empty());
+    std::string key(1,
+                    static_cast<char>(HeaderMapType::HttpCallResponseHeaders));
+    answers_[key + ":status"] = {true, status};
+    google::protobuf::Struct metadata;
+    (*metadata.mutable_fields())["NAME"].set_string_value(name);
+    std::string body = metadata.SerializeAsString();
+    FakeHost::get().setHttpCallResponseBody(body);
+    root_.onHttpCallResponse(calls().back().token, 1, body.size(), 0);
+  }
+
+  const std::vector<FakeHost::HttpCall> &calls() {
+    return FakeHost::get().httpCalls();
+  }
+
+  HostAnswers answers_;
+  RootContext root_{1, ""};
+  NodeInfo::NodeInfo node_info_;
+  PeerMetadataResolver resolver_{&root_, &node_info_};
+};
+
+TEST_F(PeerMetadataResolverTest, ResolvesSingleFlight) {
+  TestWaiter first;
+  TestWaiter second;
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 2, &first));
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 3, &second));
+  ASSERT_EQ(1, calls().size());
+  EXPECT_EQ(1, resolver_.inFlight());
+
+  respond("200", "productpage-v1");
+  EXPECT_EQ(0, resolver_.inFlight());
+  for (auto *waiter : {&first, &second}) {
+    EXPECT_EQ(1, waiter->calls);
+    ASSERT_NE(nullptr, waiter->resolved);
+    EXPECT_EQ("productpage-v1", waiter->resolved->name());
+  }
+
+  // Later streams find the peer in the cache.
+  TestWaiter third;
+  EXPECT_TRUE(resolver_.resolve("10.0.0.1", 4, &third));
+  EXPECT_EQ(1, calls().size());
+  ASSERT_NE(nullptr, resolver_.lookup("10.0.0.1"));
+  EXPECT_EQ("productpage-v1", resolver_.lookup("10.0.0.1")->name());
+}
+
+TEST_F(PeerMetadataResolverTest, FailureBacksOff) {
+  TestWaiter waiter;
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 2, &waiter));
+  respond("404");
+  EXPECT_EQ(1, waiter.calls);
+  EXPECT_EQ(nullptr, waiter.resolved);
+
+  TestWaiter next;
+  EXPECT_TRUE(resolver_.resolve("10.0.0.1", 3, &next));
+  EXPECT_EQ(1, calls().size());
+  EXPECT_EQ(0, next.calls);
+}
+
+TEST_F(PeerMetadataResolverTest, DisabledCacheBacksOff) {
+  node_info_.configureCache(-1, 0);
+  TestWaiter waiter;
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 2, &waiter));
+  respond("200", "productpage-v1");
+  // The waiting stream gets node info, although it could not be cached.
+  ASSERT_NE(nullptr, waiter.resolved);
+  EXPECT_EQ("productpage-v1", waiter.resolved->name());
+  EXPECT_EQ(nullptr, resolver_.lookup("10.0.0.1"));
+
+  TestWaiter next;
+  EXPECT_TRUE(resolver_.resolve("10.0.0.1", 3, &next));
+  EXPECT_EQ(1, calls().size());
+}
+
+TEST_F(PeerMetadataResolverTest, CancelledWaiterIsNotNotified) {
+  TestWaiter cancelled;
+  TestWaiter waiting;
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 2, &cancelled));
+  EXPECT_FALSE(resolver_.resolve("10.0.0.1", 3, &waiting));
+  resolver_.cancel("10.0.0.1", &cancelled);
+  respond("200", "productpage-v1");
+  EXPECT_EQ(0, cancelled.calls);
+  EXPECT_EQ(1, waiting.calls);
+}
+
+TEST_F(PeerMetadataResolverTest, FailedCallContinuesRightAway) {
+  FakeHost::get().acceptHttpCalls(false);
+  TestWaiter waiter;
+  EXPECT_TRUE(resolver_.resolve("10.0.0.1", 2, &waiter));
+  EXPECT_EQ(0, resolver_.inFlight());
+  EXPECT_EQ(0, waiter.calls);
+}
+
+} // namespace
+} // namespace Extension
+} // namespace Istio
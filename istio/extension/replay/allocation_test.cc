@@ -0,0 +1,192 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/exercise.h"
+#include "istio/extension/replay/fake_host.h"
+#include "istio/extension/util/allocation_tracker.h"
+
+namespace Istio {
+namespace Extension {
+namespace Replay {
+namespace {
+
+using Util::AllocationScope;
+
+typedef std::vector<std::pair<std::string, std::string>> Pairs;
+
+std::string path(std::initializer_list<StringView> parts) {
+  std::string result;
+  for (auto part : parts) {
+    if (!result.empty()) {
+      result.push_back('\0');
+    }
+    result.append(part.data(), part.size());
+  }
+  return result;
+}
+
+template <typename T> HostAnswer number(T value) {
+  return {true, std::string(reinterpret_cast<const char *>(&value),
+                            sizeof(value))};
+}
+
+// Serializes pairs as host does.
+std::string serializePairs(const Pairs &pairs) {
+  std::string out;
+  uint32_t count = pairs.size();
+  out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const auto &pair : pairs) {
+    uint32_t sizes[] = {static_cast<uint32_t>(pair.first.size()),
+                        static_cast<uint32_t>(pair.second.size())};
+    out.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  }
+  for (const auto &pair : pairs) {
+    out.append(pair.first);
+    out.push_back('\0');
+    out.append(pair.second);
+    out.push_back('\0');
+  }
+  return out;
+}
+
+void appendLengthDelimited(std::string *out, uint8_t field,
+                           const std::string &value) {
+  out->push_back(static_cast<char>(field << 3 | 2));
+  for (uint64_t size = value.size();; size >>= 7) {
+    out->push_back(static_cast<char>(size < 0x80 ? size : (size & 0x7f) | 0x80));
+    if (size < 0x80) {
+      break;
+    }
+  }
+  out->append(value);
+}
+
+// Serializes a google.protobuf.Struct of string values.
+std::string serializeStruct(const Pairs &fields) {
+  std::string out;
+  for (const auto &field : fields) {
+    std::string value;
+    appendLengthDelimited(&value, 3, field.second);
+    std::string entry;
+    appendLengthDelimited(&entry, 1, field.first);
+    appendLengthDelimited(&entry, 2, value);
+    appendLengthDelimited(&out, 1, entry);
+  }
+  return out;
+}
+
+// Host answers of an inbound request through a sidecar, as recorded at onLog.
+class StreamAllocationTest : public testing::Test {
+protected:
+  void SetUp() override {
+    root_answers_[path({"node", "metadata"})] = {
+        true, serializeStruct({{"NAME", "reviews-v1-6b9d8c7f5-2x4xq"},
+                               {"NAMESPACE", "default"},
+                               {"WORKLOAD_NAME", "reviews-v1"}})};
+    answers_[path({"listener_direction"})] = number<int64_t>(1);
+    answers_[path({"destination", "port"})] = number<int64_t>(9080);
+    answers_[path({"connection", "id"})] = number<uint64_t>(42);
+    answers_["connection"] = {
+        true, serializePairs(
+                  {{"mtls", std::string(1, '\1')},
+                   {"uri_san_peer_certificate",
+                    "spiffe://cluster.local/ns/default/sa/productpage"},
+                   {"uri_san_local_certificate",
+                    "spiffe://cluster.local/ns/default/sa/reviews"}})};
+    answers_[path({"cluster_name"})] = {
+        true, "inbound|9080|http|reviews.default.svc.cluster.local"};
+    answers_[path({"route_name"})] = {true, "default"};
+    int64_t code = 200;
+    uint64_t flags = 0;
+    answers_["response"] = {
+        true,
+        serializePairs({{"code", number(code).value},
+                        {"flags", number(flags).value},
+                        {"total_size", number<int64_t>(4096).value}})};
+    answers_[std::string(1, static_cast<char>(HeaderMapType::RequestHeaders))] =
+        {true, serializePairs({{":authority", "reviews:9080"},
+                               {":path", "/reviews/0"},
+                               {":method", "GET"},
+                               {"content-type", "application/json"},
+                               {"x-request-id", "1b4ba1b6-7d0b-4d06"},
+                               {"user-agent", "curl/7.68.0"}})};
+    answers_[path({"filter_state",
+                   "envoy.wasm.metadata_exchange.downstream_id"})] = {
+        true, "productpage-v1-7f44c4d57c-ksf9b.default"};
+    answers_[path({"filter_state",
+                   "envoy.wasm.metadata_exchange.downstream"})] = {
+        true, serializeStruct({{"NAME", "productpage-v1-7f44c4d57c-ksf9b"},
+                               {"NAMESPACE", "default"},
+                               {"WORKLOAD_NAME", "productpage-v1"}})};
+
+    auto &host = FakeHost::get();
+    host.setRootAnswers(&root_answers_);
+    host.setStreamAnswers(&answers_);
+    root_ = std::make_unique<ExtensionRootContext>(1, "");
+    // Warms node info and connection info caches up.
+    ExtensionStreamContext stream(2, root_.get());
+    exercise(stream);
+    ASSERT_EQ("productpage-v1", stream.sourceWorkloadName());
+    ASSERT_EQ(200, stream.responseCode());
+  }
+
+  void TearDown() override {
+    root_.reset();
+    FakeHost::get().setStreamAnswers(nullptr);
+    FakeHost::get().setRootAnswers(nullptr);
+  }
+
+  HostAnswers root_answers_;
+  HostAnswers answers_;
+  std::unique_ptr<ExtensionRootContext> root_;
+};
+
+TEST_F(StreamAllocationTest, AccessorsDoNotAllocateOnceLoaded) {
+  ExtensionStreamContext stream(3, root_.get());
+  exercise(stream);
+
+  AllocationScope allocations;
+  exercise(stream);
+  exercise(stream);
+  EXPECT_EQ(0, allocations.allocations());
+}
+
+// On a warm cache, a stream only allocates the WasmData wrappers of host
+// buffers it reads, which SDK allocates for every host call returning data.
+TEST_F(StreamAllocationTest, StreamAllocatesOnlyHostBuffers) {
+  auto &host = FakeHost::get();
+  host.resetCounters();
+  AllocationScope allocations;
+  {
+    ExtensionStreamContext stream(3, root_.get());
+    exercise(stream);
+    exercise(stream);
+  }
+  EXPECT_EQ(0, host.counters().unanswered_reads);
+  EXPECT_EQ(0, host.counters().peer_metadata_reads);
+  EXPECT_LE(allocations.allocations(), host.counters().reads);
+  EXPECT_EQ(0, allocations.liveAllocations());
+}
+
+} // namespace
+} // namespace Replay
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,50 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/replay/exercise.h"
+
+namespace Istio {
+namespace Extension {
+namespace Replay {
+
+void exercise(ExtensionStreamContext &stream) {
+  if (!stream.sampled()) {
+    return;
+  }
+  stream.sourceName();
+  stream.sourceNamespace();
+  stream.sourceWorkloadName();
+  stream.sourceIstioVersion();
+  stream.sourceMeshID();
+  stream.destinationName();
+  stream.destinationNamespace();
+  stream.destinationWorkloadName();
+  stream.destinationIstioVersion();
+  stream.destinationMeshID();
+  stream.destinationPort();
+  stream.responseCode();
+  stream.responseFlag();
+  stream.requestProtocol();
+  stream.serviceAuthenticationPolicy();
+  stream.sourcePrincipal();
+  stream.destinationPrincipal();
+  StringView dest_host;
+  StringView dest_name;
+  stream.destinationService(&dest_host, &dest_name);
+}
+
+} // namespace Replay
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,30 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "istio/extension/extension.h"
+
+namespace Istio {
+namespace Extension {
+namespace Replay {
+
+// Calls every telemetry accessor of a stream once, as a plugin reporting the
+// stream does at onLog.
+void exercise(ExtensionStreamContext &stream);
+
+} // namespace Replay
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,347 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/replay/fake_host.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace Istio {
+namespace Extension {
+namespace Replay {
+
+namespace {
+
+constexpr StringView kFilterStatePrefix("filter_state\0", 13);
+constexpr StringView kPeerIdSuffix = "_id";
+
+bool endsWith(StringView value, StringView suffix) {
+  return value.size() >= suffix.size() &&
+         value.substr(value.size() - suffix.size()) == suffix;
+}
+
+// Reads pairs serialized as by the SDK: the number of pairs, the sizes of
+// every key and value, then the null terminated keys and values.
+std::vector<std::pair<std::string, std::string>> readPairs(StringView data) {
+  std::vector<std::pair<std::string, std::string>> pairs;
+  uint32_t count = 0;
+  if (data.size() < sizeof(count)) {
+    return pairs;
+  }
+  ::memcpy(&count, data.data(), sizeof(count));
+  size_t sizes = sizeof(count);
+  size_t offset = sizes + count * 2 * sizeof(uint32_t);
+  for (uint32_t i = 0; i < count && offset <= data.size(); i++) {
+    uint32_t key_size = 0;
+    uint32_t value_size = 0;
+    ::memcpy(&key_size, data.data() + sizes + i * 8, sizeof(key_size));
+    ::memcpy(&value_size, data.data() + sizes + i * 8 + 4, sizeof(value_size));
+    if (offset + key_size + value_size + 2 > data.size()) {
+      break;
+    }
+    auto key = data.substr(offset, key_size);
+    offset += key_size + 1;
+    auto value = data.substr(offset, value_size);
+    offset += value_size + 1;
+    pairs.emplace_back(std::string(key.data(), key.size()),
+                       std::string(value.data(), value.size()));
+  }
+  return pairs;
+}
+
+WasmResult copyOut(StringView data, const char **value, size_t *size) {
+  char *copy = static_cast<char *>(::malloc(data.size() + 1));
+  ::memcpy(copy, data.data(), data.size());
+  copy[data.size()] = '\0';
+  *value = copy;
+  *size = data.size();
+  return WasmResult::Ok;
+}
+
+} // namespace
+
+FakeHost &FakeHost::get() {
+  static FakeHost *host = new FakeHost();
+  return *host;
+}
+
+WasmResult FakeHost::answer(const char **value, size_t *size) {
+  counters_.reads++;
+  const HostAnswer *found = nullptr;
+  for (auto *answers : {stream_answers_, root_answers_}) {
+    if (answers == nullptr) {
+      continue;
+    }
+    auto it = answers->find(key_);
+    if (it != answers->end()) {
+      found = &it->second;
+      break;
+    }
+  }
+  if (found == nullptr) {
+    counters_.unanswered_reads++;
+    return WasmResult::NotFound;
+  }
+  if (!found->found) {
+    return found->failure;
+  }
+  return copyOut(found->value, value, size);
+}
+
+WasmResult FakeHost::getProperty(StringView path, const char **value,
+                                 size_t *size) {
+  if (path.substr(0, kFilterStatePrefix.size()) == kFilterStatePrefix) {
+    if (endsWith(path, kPeerIdSuffix)) {
+      counters_.peer_id_reads++;
+    } else {
+      counters_.peer_metadata_reads++;
+    }
+  }
+  key_.assign(path.data(), path.size());
+  return answer(value, size);
+}
+
+WasmResult FakeHost::getHeaderMapValue(HeaderMapType type, StringView key,
+                                       const char **value, size_t *size) {
+  key_.assign(1, static_cast<char>(type));
+  key_.append(key.data(), key.size());
+  return answer(value, size);
+}
+
+WasmResult FakeHost::getHeaderMapPairs(HeaderMapType type, const char **value,
+                                       size_t *size) {
+  key_.assign(1, static_cast<char>(type));
+  return answer(value, size);
+}
+
+WasmResult FakeHost::getSharedData(StringView key, const char **value,
+                                   size_t *size, uint32_t *cas) {
+  auto it = shared_data_.find(std::string(key.data(), key.size()));
+  if (it == shared_data_.end()) {
+    return WasmResult::NotFound;
+  }
+  *cas = it->second.cas;
+  return copyOut(it->second.value, value, size);
+}
+
+WasmResult FakeHost::setSharedData(StringView key, StringView value,
+                                   uint32_t cas) {
+  auto &data = shared_data_[std::string(key.data(), key.size())];
+  if (cas != 0 && cas != data.cas) {
+    return WasmResult::CasMismatch;
+  }
+  data.value.assign(value.data(), value.size());
+  data.cas++;
+  return WasmResult::Ok;
+}
+
+const FakeHost::Metric *FakeHost::metric(StringView name) const {
+  for (const auto &metric : metrics_) {
+    if (metric.name == name) {
+      return &metric;
+    }
+  }
+  return nullptr;
+}
+
+void FakeHost::reset() {
+  metrics_.clear();
+  shared_data_.clear();
+  accept_http_calls_ = false;
+  http_calls_.clear();
+  http_call_response_body_.clear();
+  tick_period_ms_ = 0;
+  now_ns_ = 0;
+}
+
+uint64_t FakeHost::currentTimeNanoseconds() const {
+  if (now_ns_ != 0) {
+    return now_ns_;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+WasmResult FakeHost::getBufferBytes(BufferType type, size_t start,
+                                    size_t length, const char **value,
+                                    size_t *size) {
+  if (type != BufferType::HttpCallResponseBody ||
+      start > http_call_response_body_.size()) {
+    return WasmResult::NotFound;
+  }
+  return copyOut(StringView(http_call_response_body_).substr(start, length),
+                 value, size);
+}
+
+WasmResult FakeHost::httpCall(StringView cluster, StringView headers,
+                              StringView body, uint32_t *token) {
+  if (!accept_http_calls_) {
+    return WasmResult::InternalFailure;
+  }
+  *token = http_calls_.size() + 1;
+  http_calls_.push_back(HttpCall{*token,
+                                 std::string(cluster.data(), cluster.size()),
+                                 readPairs(headers),
+                                 std::string(body.data(), body.size())});
+  return WasmResult::Ok;
+}
+
+WasmResult FakeHost::defineMetric(MetricType type, StringView name,
+                                  uint32_t *metric_id) {
+  for (size_t i = 0; i < metrics_.size(); i++) {
+    if (metrics_[i].name == name) {
+      *metric_id = i + 1;
+      return WasmResult::Ok;
+    }
+  }
+  metrics_.push_back(Metric{type, std::string(name.data(), name.size())});
+  *metric_id = metrics_.size();
+  return WasmResult::Ok;
+}
+
+WasmResult FakeHost::incrementMetric(uint32_t metric_id, int64_t offset) {
+  if (metric_id == 0 || metric_id > metrics_.size()) {
+    return WasmResult::NotFound;
+  }
+  metrics_[metric_id - 1].value += offset;
+  return WasmResult::Ok;
+}
+
+WasmResult FakeHost::recordMetric(uint32_t metric_id, uint64_t value) {
+  if (metric_id == 0 || metric_id > metrics_.size()) {
+    return WasmResult::NotFound;
+  }
+  metrics_[metric_id - 1].value = static_cast<int64_t>(value);
+  return WasmResult::Ok;
+}
+
+} // namespace Replay
+} // namespace Extension
+} // namespace Istio
+
+using Istio::Extension::Replay::FakeHost;
+
+// proxy-wasm imports. Only those SDK calls are provided.
+
+extern "C" WasmResult proxy_log(LogLevel, const char *, size_t) {
+  return WasmResult::Ok;
+}
+
+extern "C" WasmResult proxy_get_property(const char *path_ptr,
+                                         size_t path_size,
+                                         const char **value_ptr_ptr,
+                                         size_t *value_size_ptr) {
+  return FakeHost::get().getProperty(StringView(path_ptr, path_size),
+                                     value_ptr_ptr, value_size_ptr);
+}
+
+extern "C" WasmResult proxy_get_header_map_value(HeaderMapType type,
+                                                 const char *key_ptr,
+                                                 size_t key_size,
+                                                 const char **value_ptr,
+                                                 size_t *value_size) {
+  return FakeHost::get().getHeaderMapValue(
+      type, StringView(key_ptr, key_size), value_ptr, value_size);
+}
+
+extern "C" WasmResult proxy_get_header_map_pairs(HeaderMapType type,
+                                                 const char **ptr,
+                                                 size_t *size) {
+  return FakeHost::get().getHeaderMapPairs(type, ptr, size);
+}
+
+extern "C" WasmResult proxy_get_shared_data(const char *key_ptr,
+                                            size_t key_size,
+                                            const char **value_ptr,
+                                            size_t *value_size,
+                                            uint32_t *cas) {
+  return FakeHost::get().getSharedData(StringView(key_ptr, key_size),
+                                       value_ptr, value_size, cas);
+}
+
+extern "C" WasmResult proxy_set_shared_data(const char *key_ptr,
+                                            size_t key_size,
+                                            const char *value_ptr,
+                                            size_t value_size, uint32_t cas) {
+  return FakeHost::get().setSharedData(StringView(key_ptr, key_size),
+                                       StringView(value_ptr, value_size), cas);
+}
+
+extern "C" WasmResult proxy_get_current_time_nanoseconds(uint64_t *result) {
+  *result = FakeHost::get().currentTimeNanoseconds();
+  return WasmResult::Ok;
+}
+
+extern "C" WasmResult proxy_set_tick_period_milliseconds(uint32_t period) {
+  FakeHost::get().setTickPeriodMilliseconds(period);
+  return WasmResult::Ok;
+}
+
+extern "C" WasmResult proxy_get_buffer_bytes(BufferType type, uint32_t start,
+                                             uint32_t length,
+                                             const char **value_ptr,
+                                             size_t *value_size) {
+  return FakeHost::get().getBufferBytes(type, start, length, value_ptr,
+                                        value_size);
+}
+
+extern "C" WasmResult proxy_http_call(const char *uri_ptr, size_t uri_size,
+                                      void *header_pairs_ptr,
+                                      size_t header_pairs_size,
+                                      const char *body_ptr, size_t body_size,
+                                      void *, size_t, uint32_t,
+                                      uint32_t *token_ptr) {
+  return FakeHost::get().httpCall(
+      StringView(uri_ptr, uri_size),
+      StringView(static_cast<const char *>(header_pairs_ptr),
+                 header_pairs_size),
+      StringView(body_ptr, body_size), token_ptr);
+}
+
+extern "C" WasmResult proxy_set_effective_context(uint32_t) {
+  return WasmResult::Ok;
+}
+
+extern "C" WasmResult proxy_continue_request() { return WasmResult::Ok; }
+
+extern "C" WasmResult proxy_define_metric(MetricType type,
+                                          const char *name_ptr,
+                                          size_t name_size,
+                                          uint32_t *metric_id) {
+  return FakeHost::get().defineMetric(type, StringView(name_ptr, name_size),
+                                      metric_id);
+}
+
+extern "C" WasmResult proxy_increment_metric(uint32_t metric_id,
+                                             int64_t offset) {
+  return FakeHost::get().incrementMetric(metric_id, offset);
+}
+
+extern "C" WasmResult proxy_record_metric(uint32_t metric_id, uint64_t value) {
+  return FakeHost::get().recordMetric(metric_id, value);
+}
+
+extern "C" WasmResult proxy_get_metric(uint32_t metric_id, uint64_t *result) {
+  const auto &metrics = FakeHost::get().metrics();
+  if (metric_id == 0 || metric_id > metrics.size()) {
+    return WasmResult::NotFound;
+  }
+  *result = static_cast<uint64_t>(metrics[metric_id - 1].value);
+  return WasmResult::Ok;
+}
+
+extern "C" WasmResult proxy_done() { return WasmResult::Ok; }
@@ -0,0 +1,152 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+namespace Replay {
+
+// Recorded result of a host read.
+struct HostAnswer {
+  bool found = false;
+  std::string value;
+  // Result of a read which is not found. Tests set it to a host failure,
+  // e.g. SerializationFailure of a map.
+  WasmResult failure = WasmResult::NotFound;
+};
+
+// Answers keyed as in the host trace, see Util::HostReadKind.
+typedef std::unordered_map<std::string, HostAnswer> HostAnswers;
+
+// FakeHost implements the proxy-wasm imports which SDK calls, so that SDK
+// code runs natively without a proxy. Reads are answered from a recorded
+// trace: from the answers of the current stream first, then from those of
+// the root context. Unrecorded reads are answered with NotFound. Metrics and
+// shared data are kept in memory, so that tests can check them. Http calls
+// fail, unless tests accept them. Other calls which do not read are no-ops.
+class FakeHost {
+public:
+  struct Counters {
+    uint64_t reads = 0;
+    uint64_t unanswered_reads = 0;
+    // Filter state reads of peer ids and of peer metadata. Metadata is only
+    // read on a node info cache miss.
+    uint64_t peer_id_reads = 0;
+    uint64_t peer_metadata_reads = 0;
+  };
+
+  struct Metric {
+    MetricType type;
+    std::string name;
+    // Sum of increments of a counter, or last recorded value otherwise.
+    int64_t value = 0;
+  };
+
+  struct HttpCall {
+    uint32_t token;
+    std::string cluster;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+  };
+
+  static FakeHost &get();
+
+  void setRootAnswers(const HostAnswers *answers) { root_answers_ = answers; }
+  void setStreamAnswers(const HostAnswers *answers) {
+    stream_answers_ = answers;
+  }
+
+  const Counters &counters() const { return counters_; }
+  void resetCounters() { counters_ = Counters(); }
+
+  // Gets a defined metric by name, or nullptr if it is not defined.
+  const Metric *metric(StringView name) const;
+  const std::vector<Metric> &metrics() const { return metrics_; }
+  // Makes http calls succeed and keeps them, so that tests can answer them
+  // with RootContext::onHttpCallResponse.
+  void acceptHttpCalls(bool accept) { accept_http_calls_ = accept; }
+  const std::vector<HttpCall> &httpCalls() const { return http_calls_; }
+  // Body read by SDK while handling an http call response.
+  void setHttpCallResponseBody(std::string body) {
+    http_call_response_body_ = std::move(body);
+  }
+  // Last tick period set by SDK, zero if none.
+  uint32_t tickPeriodMilliseconds() const { return tick_period_ms_; }
+  void setTickPeriodMilliseconds(uint32_t period) { tick_period_ms_ = period; }
+  // Time returned to SDK. It follows a steady clock unless a test sets it,
+  // after which it only moves when the test advances it.
+  uint64_t currentTimeNanoseconds() const;
+  void setCurrentTimeNanoseconds(uint64_t now) { now_ns_ = now; }
+  void advanceTime(uint64_t nanoseconds) { now_ns_ += nanoseconds; }
+
+  // Drops metrics, shared data, http calls and their response body, and tick
+  // period, and returns to the steady clock. Further http calls fail.
+  void reset();
+
+  // Host call implementations. Returned values are copies allocated with
+  // malloc, which SDK frees.
+  WasmResult getProperty(StringView path, const char **value, size_t *size);
+  WasmResult getHeaderMapValue(HeaderMapType type, StringView key,
+                               const char **value, size_t *size);
+  WasmResult getHeaderMapPairs(HeaderMapType type, const char **value,
+                               size_t *size);
+  WasmResult getSharedData(StringView key, const char **value, size_t *size,
+                           uint32_t *cas);
+  WasmResult setSharedData(StringView key, StringView value, uint32_t cas);
+  WasmResult defineMetric(MetricType type, StringView name,
+                          uint32_t *metric_id);
+  WasmResult incrementMetric(uint32_t metric_id, int64_t offset);
+  WasmResult recordMetric(uint32_t metric_id, uint64_t value);
+  WasmResult httpCall(StringView cluster, StringView headers, StringView body,
+                      uint32_t *token);
+  WasmResult getBufferBytes(BufferType type, size_t start, size_t length,
+                            const char **value, size_t *size);
+
+private:
+  WasmResult answer(const char **value, size_t *size);
+
+  const HostAnswers *root_answers_ = nullptr;
+  const HostAnswers *stream_answers_ = nullptr;
+  // Lookup key, reused so that lookups do not allocate.
+  std::string key_;
+  Counters counters_;
+
+  struct SharedData {
+    std::string value;
+    uint32_t cas = 0;
+  };
+  std::unordered_map<std::string, SharedData> shared_data_;
+
+  // Metric id is the index plus one.
+  std::vector<Metric> metrics_;
+
+  bool accept_http_calls_ = false;
+  std::vector<HttpCall> http_calls_;
+  std::string http_call_response_body_;
+  uint32_t tick_period_ms_ = 0;
+  // Time set by a test, or zero for the steady clock.
+  uint64_t now_ns_ = 0;
+};
+
+} // namespace Replay
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,248 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a host trace recorded by a --config=host_trace build of SDK against
+// a fake host, and reports throughput, node info cache hit rate and heap
+// allocations of SDK:
+//
+//   bazel run --config=native //istio/extension/replay:host_trace_replay --
+//       envoy.log [--iterations=N] [--streams_per_tick=N] [--cache_size=N]
+//       [--cache_ttl_seconds=N]
+//
+// The trace is read from lines carrying kHostTraceLogPrefix, e.g. an Envoy
+// log. Every recorded HTTP stream is replayed by calling all telemetry
+// accessors of a stream context, whose host reads are answered with the
+// values recorded for that stream. A stream is replayed from the last result
+// of each of its reads, not in recorded order, see addChunk. Headers other than
+// the well known ones are not traced, so replay sees them as empty or absent.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "istio/extension/extension.h"
+#include "istio/extension/replay/exercise.h"
+#include "istio/extension/replay/fake_host.h"
+#include "istio/extension/util/allocation_tracker.h"
+#include "istio/extension/util/base64.h"
+#include "istio/extension/util/host_trace.h"
+
+using Istio::Extension::ExtensionRootContext;
+using Istio::Extension::ExtensionStreamContext;
+using Istio::Extension::Replay::exercise;
+using Istio::Extension::Replay::FakeHost;
+using Istio::Extension::Replay::HostAnswers;
+using Istio::Extension::Util::AllocationScope;
+using Istio::Extension::Util::Base64;
+using Istio::Extension::Util::HostReadEvent;
+using Istio::Extension::Util::HostReadKind;
+using Istio::Extension::Util::HostTraceReader;
+using Istio::Extension::Util::kHostTraceLogPrefix;
+
+namespace {
+
+constexpr uint32_t kRootContextId = 1;
+
+struct Options {
+  std::string trace_path;
+  uint64_t iterations = 1;
+  uint64_t streams_per_tick = 1000;
+  int32_t cache_size = 0;
+  uint64_t cache_ttl_seconds =
+      Istio::Extension::NodeInfo::DefaultNodeCacheTtlSeconds;
+};
+
+struct Stream {
+  uint32_t context_id = 0;
+  HostAnswers answers;
+};
+
+struct Trace {
+  HostAnswers root_answers;
+  // Streams in the order they ended.
+  std::vector<Stream> streams;
+  uint64_t reads = 0;
+  // Contexts without a stream end, e.g. network filters or streams still
+  // open when the trace was logged. They are not replayed.
+  size_t unfinished = 0;
+};
+
+bool parseFlag(const std::string &arg, const char *name, uint64_t *value) {
+  std::string prefix = std::string("--") + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  *value = std::strtoull(arg.c_str() + prefix.size(), nullptr, 10);
+  return true;
+}
+
+bool parseOptions(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    uint64_t value = 0;
+    if (parseFlag(arg, "iterations", &options->iterations) ||
+        parseFlag(arg, "streams_per_tick", &options->streams_per_tick) ||
+        parseFlag(arg, "cache_ttl_seconds", &options->cache_ttl_seconds)) {
+      continue;
+    }
+    if (parseFlag(arg, "cache_size", &value)) {
+      options->cache_size = static_cast<int32_t>(value);
+    } else if (arg.compare(0, 2, "--") != 0 && options->trace_path.empty()) {
+      options->trace_path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options->trace_path.empty() && options->iterations > 0;
+}
+
+bool addChunk(StringView chunk, Trace *trace,
+              std::unordered_map<uint32_t, Stream> *open_streams) {
+  HostTraceReader reader(chunk);
+  HostReadEvent event;
+  while (reader.next(&event)) {
+    if (event.kind == HostReadKind::StreamEnd) {
+      auto it = open_streams->find(event.context_id);
+      if (it != open_streams->end()) {
+        trace->streams.push_back(std::move(it->second));
+        open_streams->erase(it);
+      }
+      continue;
+    }
+    trace->reads++;
+    HostAnswers *answers = &trace->root_answers;
+    if (event.context_id != 0) {
+      auto &stream = (*open_streams)[event.context_id];
+      stream.context_id = event.context_id;
+      answers = &stream.answers;
+    }
+    // Each stream collapses to a map from read to its last result. A property
+    // may be read again later in the stream with another result, e.g. the
+    // response code, and replay reads at the end of the stream, so the last
+    // result is kept. The order of reads within a stream and earlier results
+    // are lost, so replay does not reproduce reads made before a value
+    // changed, nor the cost of reads repeated in the original stream.
+    auto &answer = (*answers)[std::string(event.key.data(), event.key.size())];
+    answer.found = event.found;
+    answer.value.assign(event.value.data(), event.value.size());
+  }
+  return !reader.malformed();
+}
+
+bool readTrace(const std::string &path, Trace *trace) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::unordered_map<uint32_t, Stream> open_streams;
+  std::string line;
+  size_t malformed = 0;
+  while (std::getline(file, line)) {
+    auto pos = line.find(kHostTraceLogPrefix);
+    if (pos == std::string::npos) {
+      continue;
+    }
+    pos += strlen(kHostTraceLogPrefix);
+    auto end = line.find_first_of(" \t\r\"", pos);
+    auto encoded = StringView(line).substr(
+        pos, end == std::string::npos ? end : end - pos);
+    auto chunk = Base64::decodeWithoutPadding(encoded);
+    if (chunk.empty() || !addChunk(chunk, trace, &open_streams)) {
+      malformed++;
+    }
+  }
+  if (malformed > 0) {
+    fprintf(stderr, "skipped %zu malformed trace chunks\n", malformed);
+  }
+  trace->unfinished = open_streams.size();
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    fprintf(stderr,
+            "usage: %s <trace> [--iterations=N] [--streams_per_tick=N] "
+            "[--cache_size=N] [--cache_ttl_seconds=N]\n",
+            argv[0]);
+    return 2;
+  }
+  Trace trace;
+  if (!readTrace(options.trace_path, &trace)) {
+    return 1;
+  }
+  if (trace.streams.empty()) {
+    fprintf(stderr, "no finished streams in %s\n", options.trace_path.c_str());
+    return 1;
+  }
+  printf("trace: %zu streams, %llu reads, %zu unfinished contexts\n",
+         trace.streams.size(), static_cast<unsigned long long>(trace.reads),
+         trace.unfinished);
+
+  auto &host = FakeHost::get();
+  host.setRootAnswers(&trace.root_answers);
+  ExtensionRootContext root(kRootContextId, "host_trace_replay");
+  root.configureNodeInfoCache(options.cache_size, options.cache_ttl_seconds);
+  root.getLocalNodeInfo();
+  host.resetCounters();
+
+  uint64_t streams = 0;
+  AllocationScope allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < options.iterations; i++) {
+    for (const auto &recorded : trace.streams) {
+      host.setStreamAnswers(&recorded.answers);
+      {
+        ExtensionStreamContext stream(recorded.context_id, &root);
+        exercise(stream);
+      }
+      host.setStreamAnswers(nullptr);
+      if (++streams % options.streams_per_tick == 0) {
+        root.onTick();
+      }
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  const auto &counters = host.counters();
+  double hit_rate =
+      counters.peer_id_reads == 0
+          ? 0
+          : 1.0 - static_cast<double>(counters.peer_metadata_reads) /
+                      counters.peer_id_reads;
+  printf("replayed %llu streams in %.3fs: %.0f streams/s\n",
+         static_cast<unsigned long long>(streams), elapsed.count(),
+         streams / elapsed.count());
+  printf("host reads: %.2f per stream, %llu unanswered\n",
+         static_cast<double>(counters.reads) / streams,
+         static_cast<unsigned long long>(counters.unanswered_reads));
+  printf("node info cache: %.2f%% hit rate over %llu peer lookups\n",
+         hit_rate * 100,
+         static_cast<unsigned long long>(counters.peer_id_reads));
+  printf("allocations: %.2f per stream, %.0f bytes per stream, %lld live\n",
+         static_cast<double>(allocations.allocations()) / streams,
+         static_cast<double>(allocations.bytes()) / streams,
+         static_cast<long long>(allocations.liveAllocations()));
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/sampler.h"
+
+#include <algorithm>
+
+namespace Istio {
+namespace Extension {
+
+namespace {
+
+// Weight of the last tick in the smoothed request volume.
+constexpr double kVolumeSmoothing = 0.5;
+
+uint64_t fnv1a(StringView value) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : value) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Finalizer of splitmix64. High bits of the hash are compared with the
+// threshold, which are not well distributed for sequential stream ids or
+// request ids differing only in their last bytes.
+uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+} // namespace
+
+void Sampler::configure(const SamplerConfig &config) {
+  config_ = config;
+  config_.rate = std::min(std::max(config_.rate, 0.0), 1.0);
+  config_.min_rate = std::min(std::max(config_.min_rate, 0.0), config_.rate);
+  seen_ = 0;
+  average_seen_ = 0;
+  setRate(config_.rate);
+}
+
+bool Sampler::sample(StringView request_id) {
+  return decide(mix(fnv1a(request_id)));
+}
+
+bool Sampler::sample(uint64_t stream_id) { return decide(mix(stream_id)); }
+
+bool Sampler::decide(uint64_t hash) {
+  seen_++;
+  return threshold_ == UINT64_MAX || hash < threshold_;
+}
+
+void Sampler::onTick() {
+  if (config_.target_per_tick == 0) {
+    seen_ = 0;
+    return;
+  }
+  average_seen_ = average_seen_ == 0
+                      ? seen_
+                      : kVolumeSmoothing * seen_ +
+                            (1 - kVolumeSmoothing) * average_seen_;
+  seen_ = 0;
+  if (average_seen_ < 1) {
+    setRate(config_.rate);
+    return;
+  }
+  double rate = config_.target_per_tick / average_seen_;
+  setRate(std::min(std::max(rate, config_.min_rate), config_.rate));
+}
+
+void Sampler::setRate(double rate) {
+  rate_ = rate;
+  if (rate >= 1.0) {
+    threshold_ = UINT64_MAX;
+  } else {
+    // Resolution of 2^-32 is plenty for a sampling rate.
+    threshold_ = static_cast<uint64_t>(rate * 4294967296.0) << 32;
+  }
+}
+
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,79 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+
+struct SamplerConfig {
+  // Fraction of requests which are sampled. With adaptive sampling, this is
+  // the initial and maximum rate.
+  double rate = 1.0;
+
+  // Target number of sampled requests per tick period. If set, the rate is
+  // adjusted on every tick to follow request volume. Zero disables adaptive
+  // sampling.
+  uint64_t target_per_tick = 0;
+
+  // Lower bound of the adaptive rate.
+  double min_rate = 0.001;
+};
+
+// Sampler makes a per-request sampling decision from a hash of the request
+// id. Sidecars on the path of a request configured with the same rate make
+// the same decision. Requests without a request id are sampled by the hash of
+// their stream id.
+class Sampler {
+public:
+  Sampler() = default;
+  explicit Sampler(const SamplerConfig &config) { configure(config); }
+
+  void configure(const SamplerConfig &config);
+
+  // Whether every request is sampled and the rate is fixed. Callers use this
+  // to skip looking up the request id altogether.
+  bool sampleAll() const {
+    return threshold_ == UINT64_MAX && config_.target_per_tick == 0;
+  }
+
+  bool sample(StringView request_id);
+  bool sample(uint64_t stream_id);
+
+  // Adjusts the adaptive rate from the number of requests seen since the
+  // last tick.
+  void onTick();
+
+  double rate() const { return rate_; }
+
+private:
+  bool decide(uint64_t hash);
+  void setRate(double rate);
+
+  SamplerConfig config_;
+  double rate_ = 1.0;
+  uint64_t threshold_ = UINT64_MAX;
+
+  uint64_t seen_ = 0;
+  // Smoothed number of requests per tick.
+  double average_seen_ = 0;
+};
+
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,169 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/sampler.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace Istio {
+namespace Extension {
+namespace {
+
+// Feeds requests with distinct stream ids, and returns how many are sampled.
+uint64_t sampleRequests(Sampler *sampler, uint64_t requests) {
+  static uint64_t next_id = 0;
+  uint64_t sampled = 0;
+  for (uint64_t i = 0; i < requests; i++) {
+    sampled += sampler->sample(next_id++) ? 1 : 0;
+  }
+  return sampled;
+}
+
+SamplerConfig adaptiveConfig(uint64_t target_per_tick) {
+  SamplerConfig config;
+  config.target_per_tick = target_per_tick;
+  config.min_rate = 0.01;
+  return config;
+}
+
+TEST(SamplerTest, SamplesAllByDefault) {
+  Sampler sampler;
+  EXPECT_TRUE(sampler.sampleAll());
+  EXPECT_EQ(1000, sampleRequests(&sampler, 1000));
+}
+
+TEST(SamplerTest, SamplesFixedRate) {
+  SamplerConfig config;
+  config.rate = 0.25;
+  Sampler sampler(config);
+  EXPECT_FALSE(sampler.sampleAll());
+  auto sampled = sampleRequests(&sampler, 10000);
+  EXPECT_NEAR(2500, sampled, 250);
+}
+
+TEST(SamplerTest, SameRequestIdSameDecision) {
+  SamplerConfig config;
+  config.rate = 0.5;
+  Sampler client(config);
+  Sampler server(config);
+  size_t sampled = 0;
+  for (int i = 0; i < 1000; i++) {
+    auto request_id = "f3a1c2d4-0000-4000-8000-" + std::to_string(i);
+    bool decision = client.sample(request_id);
+    EXPECT_EQ(decision, server.sample(request_id));
+    sampled += decision ? 1 : 0;
+  }
+  EXPECT_NEAR(500, sampled, 80);
+}
+
+TEST(SamplerTest, FixedRateIgnoresTicks) {
+  SamplerConfig config;
+  config.rate = 0.5;
+  Sampler sampler(config);
+  sampleRequests(&sampler, 10000);
+  sampler.onTick();
+  EXPECT_EQ(0.5, sampler.rate());
+}
+
+TEST(SamplerTest, AdaptsRateToVolume) {
+  Sampler sampler(adaptiveConfig(100));
+  EXPECT_FALSE(sampler.sampleAll());
+  EXPECT_EQ(1.0, sampler.rate());
+
+  // The first tick takes the volume as is.
+  EXPECT_EQ(1000, sampleRequests(&sampler, 1000));
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.1, sampler.rate());
+
+  // The adapted rate holds the number of sampled requests near the target.
+  auto sampled = sampleRequests(&sampler, 1000);
+  EXPECT_NEAR(100, sampled, 40);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.1, sampler.rate());
+}
+
+TEST(SamplerTest, SmoothsVolumeChanges) {
+  Sampler sampler(adaptiveConfig(100));
+  sampleRequests(&sampler, 1000);
+  sampler.onTick();
+
+  // A drop in volume is followed over a few ticks, not at once.
+  sampleRequests(&sampler, 200);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(100.0 / 600, sampler.rate());
+  sampleRequests(&sampler, 200);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(100.0 / 400, sampler.rate());
+
+  // Rising volume lowers the rate again.
+  sampleRequests(&sampler, 5000);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(100.0 / 2700, sampler.rate());
+}
+
+TEST(SamplerTest, BoundsAdaptiveRate) {
+  auto config = adaptiveConfig(100);
+  config.rate = 0.5;
+  Sampler sampler(config);
+  EXPECT_EQ(0.5, sampler.rate());
+
+  // Never above the configured rate with low volume.
+  sampleRequests(&sampler, 10);
+  sampler.onTick();
+  EXPECT_EQ(0.5, sampler.rate());
+
+  // Never below the minimum rate with high volume.
+  for (int i = 0; i < 10; i++) {
+    sampleRequests(&sampler, 100000);
+    sampler.onTick();
+  }
+  EXPECT_EQ(0.01, sampler.rate());
+}
+
+TEST(SamplerTest, RestoresRateWhenIdle) {
+  Sampler sampler(adaptiveConfig(100));
+  sampleRequests(&sampler, 1000);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.1, sampler.rate());
+
+  // Smoothed volume halves on every idle tick, and the rate follows up to
+  // the configured rate.
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.2, sampler.rate());
+  for (int i = 0; i < 20; i++) {
+    sampler.onTick();
+  }
+  EXPECT_EQ(1.0, sampler.rate());
+  EXPECT_EQ(100, sampleRequests(&sampler, 100));
+}
+
+TEST(SamplerTest, ReconfigureResetsAdaptation) {
+  Sampler sampler(adaptiveConfig(100));
+  sampleRequests(&sampler, 1000);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.1, sampler.rate());
+
+  sampler.configure(adaptiveConfig(100));
+  EXPECT_EQ(1.0, sampler.rate());
+  sampleRequests(&sampler, 500);
+  sampler.onTick();
+  EXPECT_DOUBLE_EQ(0.2, sampler.rate());
+}
+
+} // namespace
+} // namespace Extension
+} // namespace Istio
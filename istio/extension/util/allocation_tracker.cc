@@ -0,0 +1,91 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/util/allocation_tracker.h"
+
+#ifdef ISTIO_WASM_SDK_TRACK_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+namespace {
+
+// Counters are atomic, as native harnesses may be multi-threaded. Relaxed
+// ordering is enough since they are only read as totals.
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> deallocations{0};
+std::atomic<uint64_t> bytes{0};
+
+void *trackedAllocate(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(size, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void trackedFree(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  deallocations.fetch_add(1, std::memory_order_relaxed);
+  std::free(ptr);
+}
+
+} // namespace
+
+AllocationCounters allocationCounters() {
+  AllocationCounters counters;
+  counters.allocations = allocations.load(std::memory_order_relaxed);
+  counters.deallocations = deallocations.load(std::memory_order_relaxed);
+  counters.bytes = bytes.load(std::memory_order_relaxed);
+  return counters;
+}
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
+
+using Istio::Extension::Util::trackedAllocate;
+using Istio::Extension::Util::trackedFree;
+
+void *operator new(size_t size) {
+  void *ptr = trackedAllocate(size);
+  if (ptr == nullptr) {
+    // Wasm modules are built without exceptions.
+    std::abort();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return trackedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return trackedAllocate(size);
+}
+
+void operator delete(void *ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { trackedFree(ptr); }
+
+#endif // ISTIO_WASM_SDK_TRACK_ALLOCATIONS
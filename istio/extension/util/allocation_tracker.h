@@ -0,0 +1,66 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Allocation tracking replaces global operator new and delete, and is only
+// compiled into binaries which depend on the allocation_tracker target. That
+// target defines ISTIO_WASM_SDK_TRACK_ALLOCATIONS for its dependents, so that
+// code can guard its use of the tracker, e.g. native host harnesses asserting
+// that a steady state request path does not allocate.
+#ifdef ISTIO_WASM_SDK_TRACK_ALLOCATIONS
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+struct AllocationCounters {
+  uint64_t allocations = 0;
+  uint64_t deallocations = 0;
+  uint64_t bytes = 0;
+};
+
+// Gets counters of heap allocations made since start up.
+AllocationCounters allocationCounters();
+
+// AllocationScope counts heap allocations made during its lifetime, e.g. one
+// simulated request.
+class AllocationScope {
+public:
+  AllocationScope() : start_(allocationCounters()) {}
+
+  uint64_t allocations() const {
+    return allocationCounters().allocations - start_.allocations;
+  }
+  uint64_t bytes() const { return allocationCounters().bytes - start_.bytes; }
+
+  // Allocations not freed yet.
+  int64_t liveAllocations() const {
+    auto now = allocationCounters();
+    return static_cast<int64_t>(now.allocations - start_.allocations) -
+           static_cast<int64_t>(now.deallocations - start_.deallocations);
+  }
+
+private:
+  AllocationCounters start_;
+};
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
+
+#endif // ISTIO_WASM_SDK_TRACK_ALLOCATIONS
@@ -0,0 +1,134 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/util/header_snapshot.h"
+
+#include "istio/extension/util/host_trace.h"
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+namespace {
+
+// Keys of well known headers, indexed by WellKnownHeader.
+constexpr std::array<StringView, kWellKnownHeaderCount> kWellKnownHeaderKeys{
+    ":authority",
+    ":path",
+    ":method",
+    ":scheme",
+    "content-type",
+    "x-request-id",
+    "user-agent",
+    "x-forwarded-for",
+    "x-envoy-peer-metadata",
+    "x-envoy-peer-metadata-id",
+    "referer",
+    "grpc-timeout",
+};
+
+constexpr size_t kHashTableSize = 16;
+constexpr uint8_t kEmptySlot = 0xff;
+
+// Perfect hash over kWellKnownHeaderKeys. The coefficients are chosen so that
+// every well known key lands in a distinct slot, which is verified at compile
+// time below. Keys shorter than two characters are never well known.
+constexpr size_t headerHash(StringView key) {
+  return (key.size() + 4 * static_cast<uint8_t>(key[1]) +
+          2 * static_cast<uint8_t>(key[key.size() - 1])) %
+         kHashTableSize;
+}
+
+constexpr std::array<uint8_t, kHashTableSize> buildHashTable() {
+  std::array<uint8_t, kHashTableSize> table{};
+  for (auto &slot : table) {
+    slot = kEmptySlot;
+  }
+  for (size_t i = 0; i < kWellKnownHeaderKeys.size(); i++) {
+    table[headerHash(kWellKnownHeaderKeys[i])] = static_cast<uint8_t>(i);
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, kHashTableSize> kHashTable = buildHashTable();
+
+constexpr bool isPerfectHash() {
+  for (size_t i = 0; i < kWellKnownHeaderKeys.size(); i++) {
+    if (kHashTable[headerHash(kWellKnownHeaderKeys[i])] != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(isPerfectHash(),
+              "well known header keys collide, adjust headerHash");
+
+// Returns the index of a well known header, or kEmptySlot if the key is not
+// well known.
+uint8_t wellKnownIndex(StringView key) {
+  if (key.size() < 2) {
+    return kEmptySlot;
+  }
+  auto index = kHashTable[headerHash(key)];
+  if (index == kEmptySlot || kWellKnownHeaderKeys[index] != key) {
+    return kEmptySlot;
+  }
+  return index;
+}
+
+} // namespace
+
+bool isWellKnownHeader(StringView key) {
+  return wellKnownIndex(key) != kEmptySlot;
+}
+
+bool HeaderSnapshot::load(HeaderMapType type) {
+  clear();
+  data_ = readHeaderPairs(type);
+  if (!data_) {
+    return false;
+  }
+  forEach([this](StringView key, StringView value) {
+    auto index = wellKnownIndex(key);
+    if (index != kEmptySlot && well_known_[index].data() == nullptr) {
+      well_known_[index] = value;
+    }
+  });
+  return true;
+}
+
+void HeaderSnapshot::clear() {
+  well_known_.fill(StringView());
+  data_.reset();
+}
+
+StringView HeaderSnapshot::get(StringView key) const {
+  auto index = wellKnownIndex(key);
+  if (index != kEmptySlot) {
+    return well_known_[index];
+  }
+  StringView found;
+  forEach([key, &found](StringView header, StringView value) {
+    if (found.data() == nullptr && header == key) {
+      found = value;
+    }
+  });
+  return found;
+}
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,88 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+
+#include "istio/extension/util/util.h"
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+// Headers which are looked up by SDK and plugins frequently. Their positions
+// in a header snapshot are resolved once when the snapshot is loaded.
+enum class WellKnownHeader : uint8_t {
+  Authority = 0,
+  Path,
+  Method,
+  Scheme,
+  ContentType,
+  RequestId,
+  UserAgent,
+  ForwardedFor,
+  PeerMetadata,
+  PeerMetadataId,
+  Referer,
+  GrpcTimeout,
+};
+
+constexpr size_t kWellKnownHeaderCount =
+    static_cast<size_t>(WellKnownHeader::GrpcTimeout) + 1;
+
+// Whether key is the lower case key of a well known header.
+bool isWellKnownHeader(StringView key);
+
+// HeaderSnapshot fetches a whole header map from host with a single call and
+// serves lookups as views into the host buffer. Returned views are valid until
+// the snapshot is cleared, reloaded or destroyed. Pairs are not copied out of
+// the host buffer, so that a snapshot only allocates its WasmData.
+class HeaderSnapshot {
+public:
+  // Fetches the header map of the given type from host. Returns false if the
+  // header map is not available at the current stream phase.
+  bool load(HeaderMapType type);
+
+  bool loaded() const { return data_ != nullptr; }
+
+  void clear();
+
+  // Gets value of a well known header. Empty view is returned if the header
+  // is absent.
+  StringView get(WellKnownHeader header) const {
+    return well_known_[static_cast<size_t>(header)];
+  }
+
+  // Gets value of an arbitrary header. Well known headers are served from the
+  // resolved table, other headers are looked up with a linear scan.
+  StringView get(StringView key) const;
+
+  // Calls f(key, value) for every header, in host order.
+  template <typename F> void forEach(F f) const {
+    if (data_) {
+      forEachPair(data_->view(), f);
+    }
+  }
+
+private:
+  WasmDataPtr data_;
+  std::array<StringView, kWellKnownHeaderCount> well_known_;
+};
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,306 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/util/host_trace.h"
+
+#include "istio/extension/util/base64.h"
+#include "istio/extension/util/header_snapshot.h"
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+const char kHostTraceLogPrefix[] = "host_trace: ";
+
+namespace {
+
+void appendVarint(std::string *out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void appendString(std::string *out, StringView value) {
+  appendVarint(out, value.size());
+  out->append(value.data(), value.size());
+}
+
+} // namespace
+
+void HostTraceWriter::add(uint32_t context_id, HostReadKind kind,
+                          StringView key, bool found, StringView value) {
+  if (chunks_size_ + current_.size() >= max_size_) {
+    dropped_++;
+    return;
+  }
+  appendVarint(&current_, context_id);
+  current_.push_back(static_cast<char>(kind));
+  if (kind != HostReadKind::StreamEnd) {
+    auto it = keys_.find(std::string(key.data(), key.size()));
+    if (it != keys_.end()) {
+      appendVarint(&current_, it->second);
+    } else {
+      uint32_t id = keys_.size();
+      keys_.emplace(std::string(key.data(), key.size()), id);
+      appendVarint(&current_, id);
+      appendString(&current_, key);
+    }
+    current_.push_back(found ? 1 : 0);
+    appendString(&current_, value);
+  }
+  if (current_.size() >= chunk_size_) {
+    closeChunk();
+  }
+}
+
+bool HostTraceWriter::drain(std::string *chunk) {
+  if (chunks_.empty()) {
+    closeChunk();
+  }
+  if (chunks_.empty()) {
+    return false;
+  }
+  *chunk = std::move(chunks_.front());
+  chunks_.pop_front();
+  chunks_size_ -= chunk->size();
+  return true;
+}
+
+void HostTraceWriter::closeChunk() {
+  if (current_.empty()) {
+    return;
+  }
+  chunks_size_ += current_.size();
+  chunks_.push_back(std::move(current_));
+  current_.clear();
+  keys_.clear();
+}
+
+bool HostTraceReader::next(HostReadEvent *event) {
+  if (malformed_ || pos_ == data_.size()) {
+    return false;
+  }
+  uint64_t context_id = 0;
+  if (!readVarint(&context_id) || pos_ == data_.size()) {
+    malformed_ = true;
+    return false;
+  }
+  auto kind = static_cast<uint8_t>(data_[pos_++]);
+  if (kind > static_cast<uint8_t>(HostReadKind::StreamEnd)) {
+    malformed_ = true;
+    return false;
+  }
+  *event = HostReadEvent();
+  event->context_id = static_cast<uint32_t>(context_id);
+  event->kind = static_cast<HostReadKind>(kind);
+  if (event->kind == HostReadKind::StreamEnd) {
+    return true;
+  }
+
+  uint64_t key_id = 0;
+  if (!readVarint(&key_id)) {
+    malformed_ = true;
+    return false;
+  }
+  if (key_id == keys_.size()) {
+    StringView key;
+    if (!readString(&key)) {
+      malformed_ = true;
+      return false;
+    }
+    keys_.push_back(key);
+  } else if (key_id > keys_.size()) {
+    malformed_ = true;
+    return false;
+  }
+  event->key = keys_[key_id];
+  if (pos_ == data_.size()) {
+    malformed_ = true;
+    return false;
+  }
+  event->found = data_[pos_++] != 0;
+  if (!readString(&event->value)) {
+    malformed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool HostTraceReader::readVarint(uint64_t *value) {
+  *value = 0;
+  for (uint32_t shift = 0; shift < 64 && pos_ < data_.size(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HostTraceReader::readString(StringView *value) {
+  uint64_t size = 0;
+  if (!readVarint(&size) || size > data_.size() - pos_) {
+    return false;
+  }
+  *value = data_.substr(pos_, size);
+  pos_ += size;
+  return true;
+}
+
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+
+namespace {
+
+// Chunks are logged one per line, so they are kept well below log line
+// limits. Recording stops once this much is waiting to be logged.
+constexpr size_t kHostTraceChunkSize = 16 * 1024;
+constexpr size_t kHostTraceMaxSize = 4 * 1024 * 1024;
+
+void recordRead(HostReadKind kind, StringView key, bool found,
+                StringView value) {
+  hostTrace().add(hostTraceContext(), kind, key, found, value);
+}
+
+std::string headerKey(HeaderMapType type, StringView name) {
+  std::string key(1, static_cast<char>(type));
+  key.append(name.data(), name.size());
+  return key;
+}
+
+// Header values may carry credentials, e.g. authorization or cookie, so only
+// values of well known headers are traced. Other values are recorded empty.
+// Query strings, which may carry tokens, are cut from paths and referers.
+StringView traceHeaderValue(StringView key, StringView value) {
+  if (!isWellKnownHeader(key)) {
+    return StringView();
+  }
+  if (key == ":path" || key == "referer") {
+    return value.substr(0, value.find('?'));
+  }
+  return value;
+}
+
+// Serializes the well known pairs of a header map, in the format host uses.
+std::string traceHeaderPairs(StringView pairs) {
+  std::vector<std::pair<StringView, StringView>> kept;
+  forEachPair(pairs, [&kept](StringView key, StringView value) {
+    if (isWellKnownHeader(key)) {
+      kept.emplace_back(key, traceHeaderValue(key, value));
+    }
+  });
+  std::string out;
+  uint32_t count = kept.size();
+  out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const auto &pair : kept) {
+    uint32_t sizes[] = {static_cast<uint32_t>(pair.first.size()),
+                        static_cast<uint32_t>(pair.second.size())};
+    out.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  }
+  for (const auto &pair : kept) {
+    out.append(pair.first.data(), pair.first.size());
+    out.push_back('\0');
+    out.append(pair.second.data(), pair.second.size());
+    out.push_back('\0');
+  }
+  return out;
+}
+
+} // namespace
+
+HostTraceWriter &hostTrace() {
+  static HostTraceWriter *writer =
+      new HostTraceWriter(kHostTraceChunkSize, kHostTraceMaxSize);
+  return *writer;
+}
+
+uint32_t &hostTraceContext() {
+  static uint32_t context_id = 0;
+  return context_id;
+}
+
+void recordPropertyRead(std::initializer_list<StringView> path, bool found,
+                        StringView value) {
+  std::string key;
+  for (auto part : path) {
+    if (!key.empty()) {
+      key.push_back('\0');
+    }
+    key.append(part.data(), part.size());
+  }
+  recordRead(HostReadKind::Property, key, found, value);
+}
+
+void flushHostTrace() {
+  static uint64_t reported_dropped = 0;
+  std::string chunk;
+  while (hostTrace().drain(&chunk)) {
+    LOG_INFO(kHostTraceLogPrefix +
+             Base64::encode(chunk.data(), chunk.size(), false));
+  }
+  if (hostTrace().dropped() != reported_dropped) {
+    reported_dropped = hostTrace().dropped();
+    LOG_WARN("host trace dropped " + std::to_string(reported_dropped) +
+             " reads, since it is not logged fast enough");
+  }
+}
+
+#endif // ISTIO_WASM_SDK_HOST_TRACE
+
+Optional<WasmDataPtr> readProperty(std::initializer_list<StringView> path) {
+  auto value = getProperty(path);
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  recordPropertyRead(path, value.has_value(),
+                     value ? (*value)->view() : StringView());
+#endif
+  return value;
+}
+
+WasmResult readProperty(StringView path, WasmDataPtr *value) {
+  const char *data = nullptr;
+  size_t size = 0;
+  auto result = proxy_get_property(path.data(), path.size(), &data, &size);
+  *value = result == WasmResult::Ok ? std::make_unique<WasmData>(data, size)
+                                    : nullptr;
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  recordPropertyRead({path}, *value != nullptr,
+                     *value ? (*value)->view() : StringView());
+#endif
+  return result;
+}
+
+WasmDataPtr readHeaderValue(HeaderMapType type, StringView key) {
+  auto value = getHeaderMapValue(type, key);
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  recordRead(HostReadKind::HeaderValue, headerKey(type, key), value != nullptr,
+             value ? traceHeaderValue(key, value->view()) : StringView());
+#endif
+  return value;
+}
+
+WasmDataPtr readHeaderPairs(HeaderMapType type) {
+  auto value = getHeaderMapPairs(type);
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  recordRead(HostReadKind::HeaderPairs, headerKey(type, {}), value != nullptr,
+             value ? traceHeaderPairs(value->view()) : std::string());
+#endif
+  return value;
+}
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
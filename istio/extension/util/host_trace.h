@@ -0,0 +1,184 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "proxy_wasm_intrinsics.h"
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+
+enum class HostReadKind : uint8_t {
+  // Property read, keyed by the path with parts separated by '\0', which is
+  // how it is passed to host.
+  Property = 0,
+  // Header value read, keyed by the header map type byte and header name.
+  HeaderValue = 1,
+  // Whole header map read, keyed by the header map type byte.
+  HeaderPairs = 2,
+  // Stream context destroyed. No key or value.
+  StreamEnd = 3,
+};
+
+struct HostReadEvent {
+  uint32_t context_id = 0;
+  HostReadKind kind = HostReadKind::Property;
+  StringView key;
+  bool found = false;
+  // Value as returned by host. Values of numeric properties are their bytes.
+  StringView value;
+};
+
+// HostTraceWriter encodes host reads into compact, self contained chunks.
+// Each event is a varint context id and a kind byte, followed for reads by a
+// key id, a found byte and a length prefixed value. Keys are interned per
+// chunk: the first use of a key carries the next free id followed by the
+// length prefixed key, later uses only carry the id.
+class HostTraceWriter {
+public:
+  HostTraceWriter(size_t chunk_size, size_t max_size)
+      : chunk_size_(chunk_size), max_size_(max_size) {}
+
+  void add(uint32_t context_id, HostReadKind kind, StringView key, bool found,
+           StringView value);
+
+  // Moves out the oldest complete chunk, closing the current one if there is
+  // none. Returns false if nothing has been recorded.
+  bool drain(std::string *chunk);
+
+  // Number of events dropped since recorded events reached max_size.
+  uint64_t dropped() const { return dropped_; }
+
+private:
+  void closeChunk();
+
+  const size_t chunk_size_;
+  const size_t max_size_;
+  std::deque<std::string> chunks_;
+  size_t chunks_size_ = 0;
+  std::string current_;
+  std::unordered_map<std::string, uint32_t> keys_;
+  uint64_t dropped_ = 0;
+};
+
+// HostTraceReader iterates events of a chunk produced by HostTraceWriter.
+// Views of returned events point into the chunk.
+class HostTraceReader {
+public:
+  explicit HostTraceReader(StringView chunk) : data_(chunk) {}
+
+  // Returns false at the end of the chunk, or if it is malformed.
+  bool next(HostReadEvent *event);
+  bool malformed() const { return malformed_; }
+
+private:
+  bool readVarint(uint64_t *value);
+  bool readString(StringView *value);
+
+  StringView data_;
+  size_t pos_ = 0;
+  std::vector<StringView> keys_;
+  bool malformed_ = false;
+};
+
+// Log lines carrying trace chunks start with this prefix followed by the
+// base64 encoded chunk.
+extern const char kHostTraceLogPrefix[];
+
+// Property reads of SDK go through the wrappers below. In a build with
+// --config=host_trace, which defines ISTIO_WASM_SDK_HOST_TRACE, every read is
+// recorded along with its result, and the root context logs the trace in
+// chunks on tick. istio/extension/replay replays such a trace natively.
+// Otherwise the wrappers are plain host calls. Headers other than the well
+// known ones of HeaderSnapshot are traced without their values, and left out
+// of traced header maps, and query strings are cut from :path and referer, so
+// that credentials do not end up in logs.
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+
+HostTraceWriter &hostTrace();
+
+// Context host reads are attributed to. Zero stands for the root context.
+uint32_t &hostTraceContext();
+
+// Attributes host reads made during its lifetime to a stream context.
+class HostTraceScope {
+public:
+  explicit HostTraceScope(uint32_t context_id)
+      : previous_(hostTraceContext()) {
+    hostTraceContext() = context_id;
+  }
+  ~HostTraceScope() { hostTraceContext() = previous_; }
+
+private:
+  uint32_t previous_;
+};
+
+void recordPropertyRead(std::initializer_list<StringView> path, bool found,
+                        StringView value);
+
+// Logs recorded chunks of the trace.
+void flushHostTrace();
+
+#define HOST_TRACE_SCOPE(context_id)                                           \
+  ::Istio::Extension::Util::HostTraceScope host_trace_scope(context_id)
+#define HOST_TRACE_STREAM_END(context_id)                                      \
+  ::Istio::Extension::Util::hostTrace().add(                                   \
+      context_id, ::Istio::Extension::Util::HostReadKind::StreamEnd, {},       \
+      false, {})
+
+inline StringView traceValue(const std::string &value) { return value; }
+
+template <typename T> StringView traceValue(const T &value) {
+  static_assert(std::is_arithmetic<T>::value, "unsupported property type");
+  return StringView(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+#else
+
+#define HOST_TRACE_SCOPE(context_id)
+#define HOST_TRACE_STREAM_END(context_id)
+
+#endif // ISTIO_WASM_SDK_HOST_TRACE
+
+template <typename T>
+inline bool readValue(std::initializer_list<StringView> path, T *result) {
+  bool found = getValue(path, result);
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+  recordPropertyRead(path, found, found ? traceValue(*result) : StringView());
+#endif
+  return found;
+}
+
+Optional<WasmDataPtr> readProperty(std::initializer_list<StringView> path);
+
+// Reads a property by a single part path, e.g. a whole map such as
+// "connection", and returns the host result. Unlike the above, this tells a
+// missing property from one host cannot serialize.
+WasmResult readProperty(StringView path, WasmDataPtr *value);
+
+WasmDataPtr readHeaderValue(HeaderMapType type, StringView key);
+WasmDataPtr readHeaderPairs(HeaderMapType type);
+
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
@@ -0,0 +1,222 @@
+/* Copyright 2020 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "istio/extension/util/host_trace.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "istio/extension/replay/fake_host.h"
+#include "istio/extension/util/util.h"
+
+namespace Istio {
+namespace Extension {
+namespace Util {
+namespace {
+
+struct Event {
+  uint32_t context_id;
+  HostReadKind kind;
+  std::string key;
+  bool found;
+  std::string value;
+
+  bool operator==(const Event &other) const {
+    return context_id == other.context_id && kind == other.kind &&
+           key == other.key && found == other.found && value == other.value;
+  }
+};
+
+void add(HostTraceWriter *writer, const Event &event) {
+  writer->add(event.context_id, event.kind, event.key, event.found,
+              event.value);
+}
+
+std::vector<Event> read(StringView chunk, bool *malformed = nullptr) {
+  std::vector<Event> events;
+  HostTraceReader reader(chunk);
+  HostReadEvent event;
+  while (reader.next(&event)) {
+    events.push_back({event.context_id, event.kind, std::string(event.key),
+                      event.found, std::string(event.value)});
+  }
+  if (malformed != nullptr) {
+    *malformed = reader.malformed();
+  }
+  return events;
+}
+
+const std::vector<Event> &sampleEvents() {
+  static const auto *events = new std::vector<Event>{
+      {0, HostReadKind::Property, std::string("node\0metadata", 13), true,
+       "metadata"},
+      {7, HostReadKind::Property, "cluster_name", true,
+       "inbound|9080|http|reviews.default.svc.cluster.local"},
+      {7, HostReadKind::HeaderValue, "\x02x-request-id", false, ""},
+      {7, HostReadKind::HeaderPairs, "\x02", true, std::string(4, '\0')},
+      {300, HostReadKind::Property, "cluster_name", true, "outbound"},
+      {7, HostReadKind::StreamEnd, "", false, ""},
+  };
+  return *events;
+}
+
+TEST(HostTraceTest, RoundTrip) {
+  HostTraceWriter writer(64 * 1024, 1024 * 1024);
+  for (const auto &event : sampleEvents()) {
+    add(&writer, event);
+  }
+  std::string chunk;
+  ASSERT_TRUE(writer.drain(&chunk));
+  bool malformed = true;
+  EXPECT_EQ(sampleEvents(), read(chunk, &malformed));
+  EXPECT_FALSE(malformed);
+  EXPECT_FALSE(writer.drain(&chunk));
+}
+
+TEST(HostTraceTest, InternsKeysWithinChunk) {
+  HostTraceWriter writer(64 * 1024, 1024 * 1024);
+  const std::string key(100, 'k');
+  add(&writer, {1, HostReadKind::Property, key, true, "a"});
+  add(&writer, {2, HostReadKind::Property, key, true, "b"});
+  std::string chunk;
+  ASSERT_TRUE(writer.drain(&chunk));
+  // The key is carried once.
+  EXPECT_LT(chunk.size(), 2 * key.size());
+  auto events = read(chunk);
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(key, events[0].key);
+  EXPECT_EQ(key, events[1].key);
+  EXPECT_EQ("b", events[1].value);
+}
+
+TEST(HostTraceTest, ChunksAreSelfContained) {
+  // Every event closes a chunk, so keys are declared again in each.
+  HostTraceWriter writer(1, 1024 * 1024);
+  for (const auto &event : sampleEvents()) {
+    add(&writer, event);
+  }
+  std::vector<Event> events;
+  std::string chunk;
+  size_t chunks = 0;
+  while (writer.drain(&chunk)) {
+    chunks++;
+    auto chunk_events = read(chunk);
+    ASSERT_EQ(1, chunk_events.size());
+    events.push_back(chunk_events[0]);
+  }
+  EXPECT_EQ(sampleEvents().size(), chunks);
+  EXPECT_EQ(sampleEvents(), events);
+}
+
+TEST(HostTraceTest, DropsEventsAboveMaxSize) {
+  HostTraceWriter writer(16, 64);
+  for (int i = 0; i < 20; i++) {
+    add(&writer, {1, HostReadKind::Property, "key", true, "0123456789"});
+  }
+  EXPECT_GT(writer.dropped(), 0);
+  size_t kept = 0;
+  std::string chunk;
+  while (writer.drain(&chunk)) {
+    kept += read(chunk).size();
+  }
+  EXPECT_EQ(20, kept + writer.dropped());
+}
+
+TEST(HostTraceTest, ReaderRejectsMalformedChunks) {
+  HostTraceWriter writer(64 * 1024, 1024 * 1024);
+  for (const auto &event : sampleEvents()) {
+    add(&writer, event);
+  }
+  std::string chunk;
+  ASSERT_TRUE(writer.drain(&chunk));
+
+  // Cut within the value of the last read, before the trailing stream end.
+  bool malformed = false;
+  auto events = read(StringView(chunk).substr(0, chunk.size() - 3), &malformed);
+  EXPECT_TRUE(malformed);
+  EXPECT_LT(events.size(), sampleEvents().size());
+
+  // Unknown kind.
+  read(std::string("\x01\x09", 2), &malformed);
+  EXPECT_TRUE(malformed);
+  // Key id which was never declared.
+  read(std::string("\x01\x00\x05\x01\x00", 5), &malformed);
+  EXPECT_TRUE(malformed);
+}
+
+#ifdef ISTIO_WASM_SDK_HOST_TRACE
+TEST(HostTraceTest, TracesOnlyWellKnownHeaders) {
+  std::vector<std::pair<std::string, std::string>> headers{
+      {":path", "/reviews?access_token=secret"},
+      {"referer", "http://productpage/?token=secret"},
+      {"authorization", "Bearer secret"},
+      {"x-request-id", "abc"},
+      {"cookie", "session=secret"},
+  };
+  std::string pairs;
+  uint32_t count = headers.size();
+  pairs.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const auto &header : headers) {
+    uint32_t sizes[] = {static_cast<uint32_t>(header.first.size()),
+                        static_cast<uint32_t>(header.second.size())};
+    pairs.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  }
+  for (const auto &header : headers) {
+    pairs.append(header.first).push_back('\0');
+    pairs.append(header.second).push_back('\0');
+  }
+  const std::string type(1, static_cast<char>(HeaderMapType::RequestHeaders));
+  Replay::HostAnswers answers{
+      {type, {true, pairs}},
+      {type + ":path", {true, "/reviews?access_token=secret"}},
+      {type + "authorization", {true, "Bearer secret"}},
+      {type + "x-request-id", {true, "abc"}},
+  };
+  Replay::FakeHost::get().setRootAnswers(&answers);
+  std::string chunk;
+  while (hostTrace().drain(&chunk)) {
+  }
+
+  readHeaderPairs(HeaderMapType::RequestHeaders);
+  readHeaderValue(HeaderMapType::RequestHeaders, ":path");
+  readHeaderValue(HeaderMapType::RequestHeaders, "authorization");
+  readHeaderValue(HeaderMapType::RequestHeaders, "x-request-id");
+  Replay::FakeHost::get().setRootAnswers(nullptr);
+  ASSERT_TRUE(hostTrace().drain(&chunk));
+
+  EXPECT_EQ(std::string::npos, chunk.find("secret"));
+  auto events = read(chunk);
+  ASSERT_EQ(4, events.size());
+  std::vector<std::pair<std::string, std::string>> traced;
+  EXPECT_TRUE(forEachPair(events[0].value, [&](StringView k, StringView v) {
+    traced.emplace_back(std::string(k), std::string(v));
+  }));
+  EXPECT_EQ((std::vector<std::pair<std::string, std::string>>{
+                {":path", "/reviews"},
+                {"referer", "http://productpage/"},
+                {"x-request-id", "abc"}}),
+            traced);
+  EXPECT_EQ("/reviews", events[1].value);
+  EXPECT_TRUE(events[2].found);
+  EXPECT_EQ("", events[2].value);
+  EXPECT_EQ("abc", events[3].value);
+}
+#endif
+
+} // namespace
+} // namespace Util
+} // namespace Extension
+} // namespace Istio
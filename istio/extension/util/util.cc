@@ -15,6 +15,7 @@
 
 #include "istio/extension/util/util.h"
 
+#include "istio/extension/util/host_trace.h"
 #include "proxy_wasm_intrinsics.h"
 
 namespace Istio {
@@ -76,18 +77,17 @@ enum ResponseFlag {
 };
 
 void appendString(std::string &result, const std::string &append) {
-  if (result.empty()) {
-    result = append;
-  } else {
-    result += "," + append;
+  if (!result.empty()) {
+    result.push_back(',');
   }
+  result.append(append);
 }
 
 } // namespace
 
 TrafficDirection getTrafficDirection() {
   int64_t direction;
-  if (getValue({"listener_direction"}, &direction)) {
+  if (readValue({"listener_direction"}, &direction)) {
     return static_cast<TrafficDirection>(direction);
   }
   return TrafficDirection::Unspecified;
@@ -95,6 +95,13 @@ TrafficDirection getTrafficDirection() {
 
 const std::string parseResponseFlag(uint64_t response_flag) {
   std::string result;
+  auto flag = parseResponseFlag(response_flag, &result);
+  return std::string(flag.data(), flag.size());
+}
+
+StringView parseResponseFlag(uint64_t response_flag, std::string *buffer) {
+  auto &result = *buffer;
+  result.clear();
 
   if (response_flag & FailedLocalHealthCheck) {
     appendString(result, FAILED_LOCAL_HEALTH_CHECK);
@@ -178,7 +185,7 @@ const std::string parseResponseFlag(uint64_t response_flag) {
     appendString(result, std::to_string(response_flag));
   }
 
-  return result.empty() ? NONE : result;
+  return result.empty() ? StringView(NONE) : StringView(result);
 }
 
 const std::string &
@@ -13,8 +13,13 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include <cstring>
 #include <string>
 
+#include "proxy_wasm_intrinsics.h"
+
 namespace Istio {
 namespace Extension {
 
@@ -39,9 +44,46 @@ TrafficDirection getTrafficDirection();
 // Parses an integer response flag into a readable short string.
 const std::string parseResponseFlag(uint64_t response_flag);
 
+// Same as above, but composes the string in a caller provided buffer, whose
+// capacity is reused across calls. The returned view is valid until the
+// buffer is modified.
+StringView parseResponseFlag(uint64_t response_flag, std::string *buffer);
+
 const std::string &
 authenticationPolicyString(ServiceAuthenticationPolicy policy);
 
+// Calls f(key, value) for every pair of a map which host serialized as pairs,
+// e.g. a header map: the number of pairs, the sizes of every key and value,
+// then the null terminated keys and values. Unlike WasmData::pairs(), this
+// does not allocate. Returns false if data is truncated.
+template <typename F> bool forEachPair(StringView data, F f) {
+  uint32_t count = 0;
+  if (data.size() < sizeof(count)) {
+    return data.empty();
+  }
+  ::memcpy(&count, data.data(), sizeof(count));
+  size_t sizes = sizeof(count);
+  size_t offset = sizes + static_cast<size_t>(count) * 2 * sizeof(uint32_t);
+  if (offset > data.size()) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t key_size = 0;
+    uint32_t value_size = 0;
+    ::memcpy(&key_size, data.data() + sizes, sizeof(key_size));
+    ::memcpy(&value_size, data.data() + sizes + sizeof(key_size),
+             sizeof(value_size));
+    sizes += sizeof(key_size) + sizeof(value_size);
+    if (data.size() - offset < size_t(key_size) + value_size + 2) {
+      return false;
+    }
+    f(data.substr(offset, key_size),
+      data.substr(offset + key_size + 1, value_size));
+    offset += size_t(key_size) + value_size + 2;
+  }
+  return true;
+}
+
 } // namespace Util
 } // namespace Extension
 } // namespace Istio
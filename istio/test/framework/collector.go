@@ -0,0 +1,210 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"bytes"
+	"compress/zlib"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io/ioutil"
+	"log"
+	"net"
+	"net/http"
+	"strconv"
+	"sync"
+	"time"
+)
+
+// CollectorServer is a stand-in for a telemetry collector. It accepts record
+// batches posted by the Wasm exporter on Ports.CollectorPort and keeps what it
+// received. Envoy reaches it through testdata.CollectorCluster.
+type CollectorServer struct {
+	// Path which batches are posted to. Defaults to /v1/records.
+	Path string
+	// If set, batches are answered with this status code, e.g. to exercise
+	// exporter failure handling, or a success status other than 200.
+	FailStatus int
+	// Delay before answering each batch, e.g. to exercise in flight limits.
+	Delay time.Duration
+	// If set, deflated batches are answered with 415, like a collector which
+	// does not support compression.
+	RejectCompressed bool
+
+	server     *http.Server
+	mu         sync.Mutex
+	batches    int
+	compressed int
+	records    [][]byte
+}
+
+var _ Step = &CollectorServer{}
+
+func (c *CollectorServer) Run(p *Params) error {
+	path := c.Path
+	if path == "" {
+		path = "/v1/records"
+	}
+	log.Printf("collector server listening on port %v\n", p.Ports.CollectorPort)
+	lis, err := net.Listen("tcp", fmt.Sprintf(":%d", p.Ports.CollectorPort))
+	if err != nil {
+		return err
+	}
+	m := http.NewServeMux()
+	m.HandleFunc(path, c.handle)
+	c.server = &http.Server{Handler: m}
+	go func() {
+		_ = c.server.Serve(lis)
+	}()
+	return nil
+}
+
+func (c *CollectorServer) Cleanup() {
+	log.Println("stopping collector server")
+	_ = c.server.Close()
+}
+
+func (c *CollectorServer) handle(w http.ResponseWriter, r *http.Request) {
+	deflated := false
+	switch encoding := r.Header.Get("Content-Encoding"); encoding {
+	case "":
+	case "deflate":
+		if c.RejectCompressed {
+			http.Error(w, "compressed batches are not supported", http.StatusUnsupportedMediaType)
+			return
+		}
+		deflated = true
+	default:
+		http.Error(w, "unknown content encoding "+encoding, http.StatusUnsupportedMediaType)
+		return
+	}
+	body, err := ioutil.ReadAll(r.Body)
+	if err == nil && deflated {
+		body, err = inflate(body)
+	}
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	records, err := DecodeRecordBatch(body)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if count := r.Header.Get("X-Istio-Record-Count"); count != strconv.Itoa(len(records)) {
+		http.Error(w, fmt.Sprintf("batch of %d records claims %q records", len(records), count), http.StatusBadRequest)
+		return
+	}
+	if c.Delay != 0 {
+		time.Sleep(c.Delay)
+	}
+
+	c.mu.Lock()
+	c.batches++
+	if deflated {
+		c.compressed++
+	}
+	c.records = append(c.records, records...)
+	c.mu.Unlock()
+
+	if c.FailStatus != 0 {
+		w.WriteHeader(c.FailStatus)
+		return
+	}
+	w.WriteHeader(http.StatusOK)
+}
+
+// Received returns the number of batches and the records received so far.
+func (c *CollectorServer) Received() (int, [][]byte) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.batches, c.records
+}
+
+// Compressed returns the number of deflated batches received so far.
+func (c *CollectorServer) Compressed() int {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.compressed
+}
+
+func inflate(body []byte) ([]byte, error) {
+	r, err := zlib.NewReader(bytes.NewReader(body))
+	if err != nil {
+		return nil, err
+	}
+	defer r.Close()
+	return ioutil.ReadAll(r)
+}
+
+// DecodeRecordBatch splits an exporter batch into records. Each record is
+// prefixed with its varint encoded length.
+func DecodeRecordBatch(body []byte) ([][]byte, error) {
+	var records [][]byte
+	for len(body) > 0 {
+		size, n := binary.Uvarint(body)
+		if n <= 0 || uint64(len(body)-n) < size {
+			return nil, errors.New("malformed record batch")
+		}
+		end := n + int(size)
+		records = append(records, body[n:end])
+		body = body[end:]
+	}
+	return records, nil
+}
+
+// CollectorRecords waits until the collector has received at least Min
+// records in at most MaxBatches batches, if MaxBatches is set.
+type CollectorRecords struct {
+	Collector  *CollectorServer
+	Min        int
+	MaxBatches int
+	// If set, at least this many of the batches must have been deflated.
+	MinCompressed int
+	Timeout       time.Duration
+}
+
+var _ Step = &CollectorRecords{}
+
+func (s *CollectorRecords) Run(_ *Params) error {
+	timeout := s.Timeout
+	if timeout == 0 {
+		timeout = 15 * time.Second
+	}
+	deadline := time.Now().Add(timeout)
+	for {
+		batches, records := s.Collector.Received()
+		if len(records) >= s.Min {
+			if s.MaxBatches != 0 && batches > s.MaxBatches {
+				return fmt.Errorf("collector received %d records in %d batches, want at most %d batches",
+					len(records), batches, s.MaxBatches)
+			}
+			if compressed := s.Collector.Compressed(); compressed < s.MinCompressed {
+				return fmt.Errorf("collector received %d deflated batches, want at least %d",
+					compressed, s.MinCompressed)
+			}
+			log.Printf("collector received %d records in %d batches", len(records), batches)
+			return nil
+		}
+		if time.Now().After(deadline) {
+			return fmt.Errorf("collector received %d records in %d batches, want at least %d records",
+				len(records), batches, s.Min)
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+}
+
+func (s *CollectorRecords) Cleanup() {}
@@ -0,0 +1,118 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"bytes"
+	"compress/zlib"
+	"encoding/binary"
+	"fmt"
+	"net/http"
+	"strconv"
+	"testing"
+)
+
+// exporterBatches posts batches to the collector the way the Wasm exporter
+// (istio/extension/export) does: varint length prefixed records, deflated
+// until the collector answers 415. Any 2xx status counts as delivered.
+type exporterBatches struct {
+	Batches int
+	Records int
+
+	uncompressed bool
+}
+
+var _ Step = &exporterBatches{}
+
+func (e *exporterBatches) Run(p *Params) error {
+	url := fmt.Sprintf("http://127.0.0.1:%d/v1/records", p.Ports.CollectorPort)
+	for i := 0; i < e.Batches; i++ {
+		var body bytes.Buffer
+		prefix := make([]byte, binary.MaxVarintLen64)
+		for j := 0; j < e.Records; j++ {
+			record := []byte(fmt.Sprintf("batch %d record %d", i, j))
+			body.Write(prefix[:binary.PutUvarint(prefix, uint64(len(record)))])
+			body.Write(record)
+		}
+		compressed := !e.uncompressed
+		if compressed {
+			var deflated bytes.Buffer
+			w := zlib.NewWriter(&deflated)
+			_, _ = w.Write(body.Bytes())
+			_ = w.Close()
+			body = deflated
+		}
+		req, err := http.NewRequest("POST", url, &body)
+		if err != nil {
+			return err
+		}
+		req.Header.Set("Content-Type", "application/x-istio-records")
+		req.Header.Set("X-Istio-Record-Count", strconv.Itoa(e.Records))
+		if compressed {
+			req.Header.Set("Content-Encoding", "deflate")
+		}
+		resp, err := http.DefaultClient.Do(req)
+		if err != nil {
+			return err
+		}
+		resp.Body.Close()
+		switch {
+		case resp.StatusCode/100 == 2:
+		case compressed && resp.StatusCode == http.StatusUnsupportedMediaType:
+			// Like the exporter, lose the batch and stop compressing.
+			e.uncompressed = true
+		default:
+			return fmt.Errorf("batch %d answered with %d", i, resp.StatusCode)
+		}
+	}
+	return nil
+}
+
+func (e *exporterBatches) Cleanup() {}
+
+func TestCollectorScenario(t *testing.T) {
+	deflated := &CollectorServer{}
+	rejecting := &CollectorServer{RejectCompressed: true}
+	noContent := &CollectorServer{FailStatus: http.StatusNoContent}
+	runner := &Runner{Cases: []Case{
+		{
+			Name: "deflated batches",
+			Step: &Scenario{Steps: []Step{
+				deflated,
+				&exporterBatches{Batches: 3, Records: 2},
+				&CollectorRecords{Collector: deflated, Min: 6, MaxBatches: 3, MinCompressed: 3},
+			}},
+		},
+		{
+			Name: "compression rejected",
+			Step: &Scenario{Steps: []Step{
+				rejecting,
+				&exporterBatches{Batches: 3, Records: 2},
+				&CollectorRecords{Collector: rejecting, Min: 4, MaxBatches: 2},
+			}},
+		},
+		{
+			Name: "no content answer",
+			Step: &Scenario{Steps: []Step{
+				noContent,
+				&exporterBatches{Batches: 3, Records: 2},
+				&CollectorRecords{Collector: noContent, Min: 6, MaxBatches: 3, MinCompressed: 3},
+			}},
+		},
+	}}
+	if err := runner.Run(); err != nil {
+		t.Fatal(err)
+	}
+}
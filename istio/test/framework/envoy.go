@@ -23,6 +23,7 @@ import (
 	"net/http"
 	"os"
 	"os/exec"
+	"sync"
 	"time"
 
 	core "github.com/envoyproxy/go-control-plane/envoy/api/v2/core"
@@ -90,8 +91,15 @@ func (e *Envoy) Run(p *Params) error {
 	envoyPath := ""
 	if path, exists := os.LookupEnv("ENVOY_PATH"); exists {
 		envoyPath = path
-	} else if envoyPath, err = downloadEnvoy(e.branch); err != nil {
-		return err
+	} else {
+		// Concurrent cases share the download, which unpacks into the working
+		// directory.
+		envoyDownload.Lock()
+		envoyPath, err = downloadEnvoy(e.branch)
+		envoyDownload.Unlock()
+		if err != nil {
+			return err
+		}
 	}
 	cmd := exec.Command(envoyPath, args...)
 	cmd.Stderr = os.Stderr
@@ -132,6 +140,11 @@ func (e *Envoy) Cleanup() {
 	os.Remove(e.tmpFile)
 }
 
+// Pid returns the process ID of the running Envoy.
+func (e *Envoy) Pid() int {
+	return e.cmd.Process.Pid
+}
+
 func getAdminPort(bootstrap string) (uint32, error) {
 	pb := &v2.Bootstrap{}
 	if err := ReadYAML(bootstrap, pb); err != nil {
@@ -163,6 +176,8 @@ func fillDefaultBootstrapVars(p *Params) {
 	}
 }
 
+var envoyDownload sync.Mutex
+
 // downloads env based on the given branch name. Return address of donwloaded envoy.
 func downloadEnvoy(ver string) (string, error) {
 	proxyDepUrl := fmt.Sprintf("https://raw.githubusercontent.com/istio/istio/%v/istio.deps", ver)
@@ -235,8 +250,11 @@ func (c *ClientEnvoy) Run(p *Params) error {
 	if err := u.Run(p); err != nil {
 		return err
 	}
-	c.e = &Envoy{
-		Bootstrap: testdata.ClientBootstrap,
+	// Keep an Envoy set by the scenario, which other steps may refer to.
+	if c.e == nil {
+		c.e = &Envoy{
+			Bootstrap: testdata.ClientBootstrap,
+		}
 	}
 	if err := c.e.Run(p); err != nil {
 		return err
@@ -266,8 +284,10 @@ func (s *ServerEnvoy) Run(p *Params) error {
 	if err := u.Run(p); err != nil {
 		return err
 	}
-	s.e = &Envoy{
-		Bootstrap: testdata.ServerBootstrap,
+	if s.e == nil {
+		s.e = &Envoy{
+			Bootstrap: testdata.ServerBootstrap,
+		}
 	}
 	var err error
 	if err = s.e.Run(p); err != nil {
@@ -292,6 +312,12 @@ func (s *ServerEnvoy) Cleanup() {
 	s.httpBackend.Stop()
 }
 
+// Backend returns the HTTP backend behind the server proxy, e.g. to serve
+// peer metadata.
+func (s *ServerEnvoy) Backend() *HTTPServer {
+	return s.httpBackend
+}
+
 // ClientServerEnvoy models a default client side and server side proxy
 type ClientServerEnvoy struct {
 	se          *ServerEnvoy
@@ -44,7 +44,10 @@ const (
 )
 
 type HTTPClient struct {
-	Op              HTTPOperation
+	Op HTTPOperation
+	// URL of the request. It is filled with Params when the step runs, e.g.
+	// http://127.0.0.1:{{ .Ports.ClientPort }}/, so that a case run by Runner
+	// sends it to its own Envoy.
 	URL             string
 	ReqHeaders      map[string][]string
 	ReqBody         string
@@ -56,9 +59,13 @@ type HTTPClient struct {
 var _ Step = &HTTPClient{}
 
 func (hc *HTTPClient) Run(p *Params) error {
+	url, err := p.Fill(hc.URL)
+	if err != nil {
+		return err
+	}
 	switch hc.Op {
 	case GET:
-		c, respHeaders, _, err := httpGet(hc.URL, hc.ReqHeaders)
+		c, respHeaders, _, err := httpGet(url, hc.ReqHeaders)
 		if err != nil {
 			return err
 		}
@@ -66,7 +73,7 @@ func (hc *HTTPClient) Run(p *Params) error {
 			return err
 		}
 	case POST:
-		c, respHeaders, _, err := HTTPPost(hc.URL, hc.contentType, hc.ReqHeaders, hc.ReqBody)
+		c, respHeaders, _, err := HTTPPost(url, hc.contentType, hc.ReqHeaders, hc.ReqBody)
 		if err != nil {
 			return err
 		}
@@ -108,13 +115,24 @@ func (hc *HTTPClient) checkHTTPResp(c int, respHeaders map[string][]string) erro
 func (hc *HTTPClient) Cleanup() {}
 
 func httpGet(url string, reqHeader map[string][]string) (code int, responseHeader map[string][]string, respBody string, err error) {
+	return httpGetWith(&http.Client{Timeout: httpTimeOut}, url, reqHeader)
+}
+
+// newConnectionClient opens a new connection for every request, so that a
+// response cannot come from a listener which still serves a reused
+// connection while it drains.
+var newConnectionClient = &http.Client{
+	Timeout:   httpTimeOut,
+	Transport: &http.Transport{DisableKeepAlives: true},
+}
+
+func httpGetWith(client *http.Client, url string, reqHeader map[string][]string) (code int, responseHeader map[string][]string, respBody string, err error) {
 	log.Println("HTTP GET", url)
 	req, err := http.NewRequest("GET", url, nil)
 	if err != nil {
 		log.Fatal("Error reading request. ", err)
 	}
 	req.Header = reqHeader
-	client := &http.Client{Timeout: httpTimeOut}
 	resp, err := client.Do(req)
 	if err != nil {
 		log.Println(err)
@@ -27,6 +27,9 @@ import (
 	"strings"
 	"sync"
 	"time"
+
+	"github.com/golang/protobuf/proto"
+	structpb "github.com/golang/protobuf/ptypes/struct"
 )
 
 // If HTTP header has non empty FailHeader,
@@ -80,7 +83,10 @@ type HTTPServer struct {
 	TLSConfig   *tls.Config
 
 	reqHeaders http.Header
-	mu         sync.Mutex
+	// Serialized node metadata served by the peer metadata handler, keyed by
+	// peer address.
+	peerMetadata map[string][]byte
+	mu           sync.Mutex
 }
 
 func pubkeyHandler(w http.ResponseWriter, _ *http.Request) {
@@ -135,6 +141,42 @@ func (s *HTTPServer) handle(w http.ResponseWriter, r *http.Request) {
 	_, _ = w.Write(body)
 }
 
+// handlePeerMetadata serves node metadata of the peer with the address in the
+// address query parameter as a serialized google.protobuf.Struct, standing in
+// for the peer metadata service of the extension.
+func (s *HTTPServer) handlePeerMetadata(w http.ResponseWriter, r *http.Request) {
+	address := r.URL.Query().Get("address")
+	s.mu.Lock()
+	metadata, ok := s.peerMetadata[address]
+	s.mu.Unlock()
+	if !ok {
+		http.NotFound(w, r)
+		return
+	}
+	w.Header().Set("content-type", "application/x-protobuf")
+	_, _ = w.Write(metadata)
+}
+
+// SetPeerMetadata sets node metadata served for a peer address. A nil
+// metadata removes the peer, which is then answered with 404.
+func (s *HTTPServer) SetPeerMetadata(address string, metadata *structpb.Struct) error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if metadata == nil {
+		delete(s.peerMetadata, address)
+		return nil
+	}
+	out, err := proto.Marshal(metadata)
+	if err != nil {
+		return err
+	}
+	if s.peerMetadata == nil {
+		s.peerMetadata = make(map[string][]byte)
+	}
+	s.peerMetadata[address] = out
+	return nil
+}
+
 // NewHTTPServer creates a new HTTP server.
 func NewHTTPServer(port uint16, enableTLS bool, rootDir string) (*HTTPServer, error) {
 	log.Printf("Http server listening on port %v\n", port)
@@ -186,6 +228,7 @@ func (s *HTTPServer) Start() <-chan error {
 		m := http.NewServeMux()
 		m.HandleFunc("/", s.handle)
 		m.HandleFunc("/pubkey", pubkeyHandler)
+		m.HandleFunc("/v1/peer", s.handlePeerMetadata)
 		server := http.Server{
 			Addr:      fmt.Sprintf(":%d", s.port),
 			Handler:   m,
@@ -46,31 +46,36 @@ type Ports struct {
 	ClientPort      uint16
 	ServerPort      uint16
 	XDSPort         uint16
+	CollectorPort   uint16
 	Max             uint16
 }
 
+// AllocatePorts reserves the next block of portNum free ports. It is safe to
+// call from concurrently running scenarios, which never share a block.
 func (p *PortAllocator) AllocatePorts() (*Ports, error) {
 	p.mux.Lock()
-	p.mux.Unlock()
-	base := portBase + p.testIndex*portNum
-	for base+portNum <= 65535 {
-		if allPortFree(base, portNum) {
+	defer p.mux.Unlock()
+	base := int(portBase) + int(p.testIndex)*int(portNum)
+	for ; base+int(portNum) <= 65535; base += int(portNum) {
+		if allPortFree(uint16(base), portNum) {
 			break
 		}
-		base += p.testIndex * portNum
 	}
-	if base+portNum > 65535 {
+	if base+int(portNum) > 65535 {
 		return nil, errors.New("Cannot find valid port range for test")
 	}
-	p.testIndex += 1
+	// Skip blocks found in use, so later allocations do not probe them again.
+	p.testIndex = uint16((base-int(portBase))/int(portNum) + 1)
+	b := uint16(base)
 	return &Ports{
-		BackendPort:     base,
-		ClientAdminPort: base + 1,
-		ServerAdminPort: base + 2,
-		ClientPort:      base + 3,
-		ServerPort:      base + 4,
-		XDSPort:         base + 5,
-		Max:             base + 5,
+		BackendPort:     b,
+		ClientAdminPort: b + 1,
+		ServerAdminPort: b + 2,
+		ClientPort:      b + 3,
+		ServerPort:      b + 4,
+		XDSPort:         b + 5,
+		CollectorPort:   b + 6,
+		Max:             b + 6,
 	}, nil
 }
 
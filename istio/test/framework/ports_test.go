@@ -0,0 +1,70 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"fmt"
+	"net"
+	"testing"
+)
+
+func TestAllocatePortsReturnsDisjointBlocks(t *testing.T) {
+	// Far from the blocks of the shared allocator, which other tests use.
+	allocator := &PortAllocator{testIndex: 1000}
+	first, err := allocator.AllocatePorts()
+	if err != nil {
+		t.Fatal(err)
+	}
+	second, err := allocator.AllocatePorts()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if first.Max >= second.BackendPort {
+		t.Errorf("blocks %d-%d and %d-%d overlap", first.BackendPort, first.Max, second.BackendPort, second.Max)
+	}
+	ports := []uint16{first.BackendPort, first.ClientAdminPort, first.ServerAdminPort,
+		first.ClientPort, first.ServerPort, first.XDSPort, first.CollectorPort}
+	seen := map[uint16]bool{}
+	for _, port := range ports {
+		if seen[port] || port < first.BackendPort || port > first.Max {
+			t.Errorf("port %d is reused or outside block %d-%d", port, first.BackendPort, first.Max)
+		}
+		seen[port] = true
+	}
+}
+
+func TestAllocatePortsSkipsBlocksInUse(t *testing.T) {
+	allocator := &PortAllocator{testIndex: 1100}
+	base := portBase + 1100*portNum
+	lis, err := net.Listen("tcp", fmt.Sprintf("127.0.0.1:%d", base+3))
+	if err != nil {
+		t.Skipf("cannot listen on port %d: %v", base+3, err)
+	}
+	defer lis.Close()
+	ports, err := allocator.AllocatePorts()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if ports.BackendPort < base+portNum {
+		t.Errorf("got block from %d, want a block after the one in use at %d", ports.BackendPort, base)
+	}
+	next, err := allocator.AllocatePorts()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if next.BackendPort != ports.BackendPort+portNum {
+		t.Errorf("got block from %d after %d, want the next block", next.BackendPort, ports.BackendPort)
+	}
+}
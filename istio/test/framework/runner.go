@@ -0,0 +1,118 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"fmt"
+	"log"
+	"runtime"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Case is an independent scenario run by Runner, with its own Params.
+type Case struct {
+	Name string
+	// Vars of the case Params. The map is copied, so cases may share it.
+	Vars map[string]string
+	Step Step
+}
+
+type CaseResult struct {
+	Name string
+	// Wall time of the case, including allocating its ports and running
+	// cleanup of its steps.
+	Duration time.Duration
+	Err      error
+}
+
+// Runner runs independent cases concurrently. Every case gets its own block
+// of ports from the port allocator, so their Envoys, backends and XDS servers
+// do not collide. Steps must not share state across cases. Since ports are
+// allocated when a case starts, steps refer to them through Params, e.g.
+// HTTPClient.URL and Stats.AdminPortTemplate are filled when they run.
+type Runner struct {
+	Cases []Case
+	// Maximum number of cases running at once. Defaults to GOMAXPROCS.
+	Parallelism int
+
+	Results []CaseResult
+}
+
+func (r *Runner) Run() error {
+	parallelism := r.Parallelism
+	if parallelism <= 0 {
+		parallelism = runtime.GOMAXPROCS(0)
+	}
+	start := time.Now()
+	r.Results = make([]CaseResult, len(r.Cases))
+	slots := make(chan struct{}, parallelism)
+	var wg sync.WaitGroup
+	for i := range r.Cases {
+		wg.Add(1)
+		slots <- struct{}{}
+		go func(i int) {
+			defer func() {
+				<-slots
+				wg.Done()
+			}()
+			r.Results[i] = runCase(&r.Cases[i])
+		}(i)
+	}
+	wg.Wait()
+	return r.report(time.Since(start))
+}
+
+func runCase(c *Case) CaseResult {
+	start := time.Now()
+	vars := make(map[string]string, len(c.Vars))
+	for k, v := range c.Vars {
+		vars[k] = v
+	}
+	p, err := NewTestParams(vars)
+	if err == nil {
+		log.Printf("case %q running on ports %d-%d", c.Name, p.Ports.BackendPort, p.Ports.Max)
+		err = c.Step.Run(p)
+		c.Step.Cleanup()
+	}
+	result := CaseResult{Name: c.Name, Duration: time.Since(start), Err: err}
+	log.Printf("case %q finished in %v, error: %v", c.Name, result.Duration, err)
+	return result
+}
+
+// report logs the wall time of every case, slowest first, and returns an
+// error listing the failed cases.
+func (r *Runner) report(elapsed time.Duration) error {
+	results := append([]CaseResult(nil), r.Results...)
+	sort.Slice(results, func(i, j int) bool { return results[i].Duration > results[j].Duration })
+	var total time.Duration
+	var failed []string
+	for _, result := range results {
+		total += result.Duration
+		status := "ok"
+		if result.Err != nil {
+			status = "FAIL"
+			failed = append(failed, fmt.Sprintf("%s: %v", result.Name, result.Err))
+		}
+		log.Printf("%-40s %-4s %v", result.Name, status, result.Duration)
+	}
+	log.Printf("%d cases in %v wall time, %v total case time", len(results), elapsed, total)
+	if len(failed) > 0 {
+		return fmt.Errorf("%d of %d cases failed:\n%s", len(failed), len(results), strings.Join(failed, "\n"))
+	}
+	return nil
+}
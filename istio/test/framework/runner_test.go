@@ -0,0 +1,95 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"fmt"
+	"net"
+	"net/http"
+	"strconv"
+	"testing"
+
+	dto "github.com/prometheus/client_model/go"
+)
+
+// fakeAdmin stands in for the admin endpoint of a case's server Envoy. It
+// reports istio_requests_total as the case's "requests" var, so that a Stats
+// step reading another case's endpoint sees the wrong value.
+type fakeAdmin struct {
+	server *http.Server
+}
+
+var _ Step = &fakeAdmin{}
+
+func (a *fakeAdmin) Run(p *Params) error {
+	lis, err := net.Listen("tcp", fmt.Sprintf(":%d", p.Ports.ServerAdminPort))
+	if err != nil {
+		return err
+	}
+	requests := p.Vars["requests"]
+	m := http.NewServeMux()
+	m.HandleFunc("/stats/prometheus", func(w http.ResponseWriter, _ *http.Request) {
+		fmt.Fprintf(w, "# TYPE istio_requests_total counter\nistio_requests_total %s\n", requests)
+	})
+	m.HandleFunc("/ready", func(w http.ResponseWriter, _ *http.Request) {})
+	a.server = &http.Server{Handler: m}
+	go func() {
+		_ = a.server.Serve(lis)
+	}()
+	return nil
+}
+
+func (a *fakeAdmin) Cleanup() {
+	_ = a.server.Close()
+}
+
+// requestsVar matches a counter whose value is the case's "requests" var.
+type requestsVar struct{}
+
+func (requestsVar) Matches(p *Params, family *dto.MetricFamily) error {
+	want, err := strconv.ParseFloat(p.Vars["requests"], 64)
+	if err != nil {
+		return err
+	}
+	if len(family.Metric) != 1 || family.Metric[0].GetCounter().GetValue() != want {
+		return fmt.Errorf("got %v, want counter %v", family.Metric, want)
+	}
+	return nil
+}
+
+func TestRunnerCasesUseOwnPorts(t *testing.T) {
+	var cases []Case
+	for i := 1; i <= 2; i++ {
+		cases = append(cases, Case{
+			Name: fmt.Sprintf("case %d", i),
+			Vars: map[string]string{"requests": strconv.Itoa(i)},
+			Step: &Scenario{Steps: []Step{
+				&fakeAdmin{},
+				&HTTPClient{
+					URL:          "http://127.0.0.1:{{ .Ports.ServerAdminPort }}/ready",
+					WantRespCode: http.StatusOK,
+				},
+				&Stats{
+					AdminPortTemplate: "{{ .Ports.ServerAdminPort }}",
+					Matchers:          map[string]StatMatcher{"istio_requests_total": requestsVar{}},
+				},
+			}},
+		})
+	}
+	runner := &Runner{Cases: cases, Parallelism: 2}
+	if err := runner.Run(); err != nil {
+		t.Fatal(err)
+	}
+}
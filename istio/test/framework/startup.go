@@ -0,0 +1,283 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"log"
+	"net/http"
+	"net/url"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+)
+
+const (
+	listenerCreateSuccessStat = "listener_manager.listener_create_success"
+	listenersDrainingStat     = "listener_manager.total_listeners_draining"
+)
+
+// Reconfiguration pushes a listener update through the XDS step N times. For
+// every push it measures the time until a request is served by the new
+// listener, i.e. by freshly created plugin VMs, and the memory Envoy uses for
+// them. The XDS and Envoy steps must run before it.
+type Reconfiguration struct {
+	// Update pushed on every iteration. Params.N is set to the iteration, so
+	// Version and listeners should refer to {{ .N }} to make every push a new
+	// config.
+	Update *Update
+	// Envoy receiving the update. Its admin endpoint and process are sampled.
+	Envoy *Envoy
+	// Request sent after every push, which must go through the new listener.
+	// It is filled with Params, e.g. http://127.0.0.1:{{ .Ports.ServerPort }}.
+	URL        string
+	ReqHeaders map[string][]string
+	// If set, a request only counts as served by the new plugin instance once
+	// this response header carries the pushed version, e.g. when the plugin
+	// echoes a version from its configuration. Otherwise the first successful
+	// request on a new connection after the new listener is created counts.
+	VersionHeader string
+
+	N int
+	// Maximum time to wait for a push to be served, and for the replaced
+	// listener to drain.
+	Timeout time.Duration
+	// Number of plugin VMs created by a push, which is the number of workers
+	// plus the main thread. Defaults to 2, matching --concurrency 1.
+	VMs int
+	// Fail if the median push to first request latency exceeds it.
+	MaxMedianLatency time.Duration
+
+	Results []ReconfigurationResult
+}
+
+type ReconfigurationResult struct {
+	// Time from the push to the first request served by the new listener.
+	Latency time.Duration
+	// Memory in use by Envoy once the replaced listener has drained, and
+	// growth per plugin VM while both listeners were live. See getMemoryInUse.
+	InUseBytes uint64
+	PerVMBytes int64
+}
+
+var _ Step = &Reconfiguration{}
+
+func (r *Reconfiguration) Run(p *Params) error {
+	timeout := r.Timeout
+	if timeout == 0 {
+		timeout = 30 * time.Second
+	}
+	vms := r.VMs
+	if vms == 0 {
+		vms = 2
+	}
+	url, err := p.Fill(r.URL)
+	if err != nil {
+		return err
+	}
+	adminPort := uint16(r.Envoy.adminPort)
+	r.Results = r.Results[:0]
+	for i := 0; i < r.N; i++ {
+		p.N = i
+		created, err := getStatValue(adminPort, listenerCreateSuccessStat)
+		if err != nil {
+			return err
+		}
+		// Listeners replaced by the previous push hold their VMs until they
+		// drain, so sample only once none are left.
+		if err := waitForDrained(adminPort, time.Now().Add(timeout)); err != nil {
+			return fmt.Errorf("push %d: %v", i, err)
+		}
+		before, err := getMemoryInUse(adminPort, r.Envoy.Pid())
+		if err != nil {
+			return err
+		}
+
+		start := time.Now()
+		if err := r.Update.Run(p); err != nil {
+			return err
+		}
+		version, err := p.Fill(r.Update.Version)
+		if err != nil {
+			return err
+		}
+		deadline := start.Add(timeout)
+		if err := r.waitForListener(adminPort, created, deadline); err != nil {
+			return fmt.Errorf("push %d: %v", i, err)
+		}
+		if err := r.waitForRequest(url, version, deadline); err != nil {
+			return fmt.Errorf("push %d: %v", i, err)
+		}
+		latency := time.Since(start)
+
+		// The replaced listener is draining, so the growth is the new VMs.
+		live, err := getMemoryInUse(adminPort, r.Envoy.Pid())
+		if err != nil {
+			return err
+		}
+		if err := waitForDrained(adminPort, time.Now().Add(timeout)); err != nil {
+			return fmt.Errorf("push %d: %v", i, err)
+		}
+		after, err := getMemoryInUse(adminPort, r.Envoy.Pid())
+		if err != nil {
+			return err
+		}
+		result := ReconfigurationResult{
+			Latency:    latency,
+			InUseBytes: after,
+			PerVMBytes: (int64(live) - int64(before)) / int64(vms),
+		}
+		log.Printf("push %d served after %v, %d bytes in use, %d bytes per VM",
+			i, result.Latency, result.InUseBytes, result.PerVMBytes)
+		r.Results = append(r.Results, result)
+	}
+	return r.report()
+}
+
+func (r *Reconfiguration) Cleanup() {}
+
+func (r *Reconfiguration) waitForListener(adminPort uint16, created uint64, deadline time.Time) error {
+	for {
+		current, err := getStatValue(adminPort, listenerCreateSuccessStat)
+		if err != nil {
+			return err
+		}
+		if current > created {
+			return nil
+		}
+		if time.Now().After(deadline) {
+			return fmt.Errorf("listener update was not applied before deadline")
+		}
+		time.Sleep(50 * time.Millisecond)
+	}
+}
+
+func (r *Reconfiguration) waitForRequest(url, version string, deadline time.Time) error {
+	for {
+		// Each probe opens a new connection, as the replaced listener keeps
+		// serving connections it accepted until they drain.
+		code, headers, _, err := httpGetWith(newConnectionClient, url, r.ReqHeaders)
+		if err == nil && code == http.StatusOK {
+			if r.VersionHeader == "" || http.Header(headers).Get(r.VersionHeader) == version {
+				return nil
+			}
+		}
+		if time.Now().After(deadline) {
+			return fmt.Errorf("no request served by config version %q before deadline", version)
+		}
+		time.Sleep(50 * time.Millisecond)
+	}
+}
+
+func (r *Reconfiguration) report() error {
+	if len(r.Results) == 0 {
+		return nil
+	}
+	latencies := make([]time.Duration, 0, len(r.Results))
+	var perVM int64
+	for _, result := range r.Results {
+		latencies = append(latencies, result.Latency)
+		perVM += result.PerVMBytes
+	}
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	median := latencies[len(latencies)/2]
+	log.Printf("reconfiguration: %d pushes, latency min %v median %v max %v, %d bytes per VM on average",
+		len(latencies), latencies[0], median, latencies[len(latencies)-1], perVM/int64(len(r.Results)))
+	if r.MaxMedianLatency != 0 && median > r.MaxMedianLatency {
+		return fmt.Errorf("median push to first request latency %v exceeds %v", median, r.MaxMedianLatency)
+	}
+	return nil
+}
+
+// getStatValue reads a counter or gauge from the Envoy admin endpoint.
+func getStatValue(adminPort uint16, name string) (uint64, error) {
+	filter := url.QueryEscape("^" + strings.ReplaceAll(name, ".", `\.`) + "$")
+	_, _, body, err := httpGet(fmt.Sprintf("http://127.0.0.1:%d/stats?filter=%s", adminPort, filter), map[string][]string{})
+	if err != nil {
+		return 0, err
+	}
+	for _, line := range strings.Split(body, "\n") {
+		parts := strings.SplitN(line, ": ", 2)
+		if len(parts) == 2 && parts[0] == name {
+			return strconv.ParseUint(strings.TrimSpace(parts[1]), 10, 64)
+		}
+	}
+	// Counters are not reported until they are incremented.
+	return 0, nil
+}
+
+// waitForDrained waits until no listener of Envoy is draining.
+func waitForDrained(adminPort uint16, deadline time.Time) error {
+	for {
+		draining, err := getStatValue(adminPort, listenersDrainingStat)
+		if err != nil {
+			return err
+		}
+		if draining == 0 {
+			return nil
+		}
+		if time.Now().After(deadline) {
+			return fmt.Errorf("%d listeners still draining after deadline", draining)
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+}
+
+// getMemoryInUse returns the resident memory of the Envoy process, less the
+// free memory tcmalloc keeps from the admin /memory endpoint. Resident memory
+// includes Wasm linear memory, which V8 maps outside of tcmalloc, while
+// tcmalloc does not return freed pages to the kernel right away. Without
+// tcmalloc the endpoint reports zeros and this is plain resident memory.
+func getMemoryInUse(adminPort uint16, pid int) (uint64, error) {
+	rss, err := getResidentMemory(pid)
+	if err != nil {
+		return 0, err
+	}
+	_, _, body, err := httpGet(fmt.Sprintf("http://127.0.0.1:%d/memory", adminPort), map[string][]string{})
+	if err != nil {
+		return 0, err
+	}
+	var memory struct {
+		PageheapFree     uint64 `json:"pageheap_free,string"`
+		TotalThreadCache uint64 `json:"total_thread_cache,string"`
+	}
+	if err := json.Unmarshal([]byte(body), &memory); err != nil {
+		return 0, fmt.Errorf("cannot parse memory stats %q: %v", body, err)
+	}
+	free := memory.PageheapFree + memory.TotalThreadCache
+	if free > rss {
+		return 0, nil
+	}
+	return rss - free, nil
+}
+
+// getResidentMemory reads VmRSS of a process from /proc.
+func getResidentMemory(pid int) (uint64, error) {
+	status, err := ioutil.ReadFile(fmt.Sprintf("/proc/%d/status", pid))
+	if err != nil {
+		return 0, err
+	}
+	for _, line := range strings.Split(string(status), "\n") {
+		fields := strings.Fields(line)
+		if len(fields) == 3 && fields[0] == "VmRSS:" && fields[2] == "kB" {
+			kb, err := strconv.ParseUint(fields[1], 10, 64)
+			return kb * 1024, err
+		}
+	}
+	return 0, fmt.Errorf("no VmRSS in /proc/%d/status", pid)
+}
@@ -0,0 +1,93 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"net"
+	"net/http"
+	"net/http/httptest"
+	"strings"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/bianpengyuan/istio-wasm-sdk/istio/test/testdata"
+)
+
+// TestReconfigurationScenario pushes the default server listener with a new
+// stat prefix on every iteration, so that Envoy replaces it along with its
+// plugin VMs. It runs Envoy, which is downloaded unless ENVOY_PATH is set.
+func TestReconfigurationScenario(t *testing.T) {
+	if testing.Short() {
+		t.Skip("runs Envoy")
+	}
+	listener := strings.Replace(testdata.DefaultServerListener,
+		"stat_prefix: server", "stat_prefix: server-{{ .N }}", 1)
+	envoy := &Envoy{Bootstrap: testdata.ServerBootstrap}
+	reconfiguration := &Reconfiguration{
+		Update: &Update{
+			Node:      "server",
+			Version:   "push-{{ .N }}",
+			Listeners: []string{listener},
+		},
+		Envoy:            envoy,
+		URL:              "http://127.0.0.1:{{ .Ports.ServerPort }}/",
+		N:                3,
+		MaxMedianLatency: 10 * time.Second,
+	}
+	runner := &Runner{Cases: []Case{
+		{
+			Name: "server listener pushes",
+			Step: &Scenario{Steps: []Step{
+				&XDS{},
+				&ServerEnvoy{e: envoy},
+				reconfiguration,
+			}},
+		},
+	}}
+	if err := runner.Run(); err != nil {
+		t.Fatal(err)
+	}
+	if len(reconfiguration.Results) != reconfiguration.N {
+		t.Fatalf("got %d results for %d pushes", len(reconfiguration.Results), reconfiguration.N)
+	}
+	for i, result := range reconfiguration.Results {
+		if result.InUseBytes == 0 {
+			t.Errorf("push %d: no memory in use reported", i)
+		}
+	}
+}
+
+// TestReconfigurationProbeOpensNewConnections checks that probes after a
+// push cannot be answered on a connection accepted by the replaced listener.
+func TestReconfigurationProbeOpensNewConnections(t *testing.T) {
+	var connections int32
+	server := httptest.NewUnstartedServer(http.HandlerFunc(func(w http.ResponseWriter, _ *http.Request) {}))
+	server.Config.ConnState = func(_ net.Conn, state http.ConnState) {
+		if state == http.StateNew {
+			atomic.AddInt32(&connections, 1)
+		}
+	}
+	server.Start()
+	defer server.Close()
+	for i := 0; i < 3; i++ {
+		if code, _, _, err := httpGetWith(newConnectionClient, server.URL, map[string][]string{}); err != nil || code != http.StatusOK {
+			t.Fatalf("probe %d: code %d, error %v", i, code, err)
+		}
+	}
+	if got := atomic.LoadInt32(&connections); got != 3 {
+		t.Errorf("3 probes opened %d connections, want 3", got)
+	}
+}
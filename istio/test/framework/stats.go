@@ -18,7 +18,10 @@ import (
 	"errors"
 	"fmt"
 	"log"
+	"net/url"
+	"regexp"
 	"sort"
+	"strconv"
 	"strings"
 	"time"
 
@@ -28,8 +31,22 @@ import (
 )
 
 type Stats struct {
+	// Admin port of the Envoy whose stats are checked.
 	AdminPort uint16
-	Matchers  map[string]StatMatcher
+	// Admin port as a Params template, e.g. {{ .Ports.ServerAdminPort }}. It
+	// is filled when the step runs, so that a case run by Runner checks its
+	// own Envoy. It takes precedence over AdminPort.
+	AdminPortTemplate string
+	Matchers          map[string]StatMatcher
+	// Regex passed to the admin endpoint as ?filter=, so that only the stats
+	// under test are dumped and parsed. By default it matches the names of
+	// the matched metrics, which works for custom stats such as
+	// istio_requests_total. Envoy prefixes its own stats with envoy_ in the
+	// Prometheus output only, so if any matcher refers to one the default is
+	// to dump all stats.
+	Filter string
+	// Maximum time to wait for all matchers to match. Defaults to 15s.
+	Timeout time.Duration
 }
 
 type StatMatcher interface {
@@ -39,15 +56,27 @@ type StatMatcher interface {
 var _ Step = &Stats{}
 
 func (s *Stats) Run(p *Params) error {
-	for i := 0; i < 15; i++ {
-		_, _, body, err := httpGet(fmt.Sprintf("http://127.0.0.1:%d/stats/prometheus", s.AdminPort), map[string][]string{})
+	timeout := s.Timeout
+	if timeout == 0 {
+		timeout = 15 * time.Second
+	}
+	adminPort, err := s.adminPort(p)
+	if err != nil {
+		return err
+	}
+	statsURL := fmt.Sprintf("http://127.0.0.1:%d/stats/prometheus", adminPort)
+	if filter := s.filter(); filter != "" {
+		statsURL += "?filter=" + url.QueryEscape(filter)
+	}
+	err = pollWithBackoff(timeout, func() (bool, error) {
+		_, _, body, err := httpGet(statsURL, map[string][]string{})
 		if err != nil {
-			return err
+			return false, err
 		}
 		reader := strings.NewReader(body)
 		metrics, err := (&expfmt.TextParser{}).TextToMetricFamilies(reader)
 		if err != nil {
-			return err
+			return false, err
 		}
 		count := 0
 		for _, metric := range metrics {
@@ -63,12 +92,73 @@ func (s *Stats) Run(p *Params) error {
 			}
 		}
 		if count == len(s.Matchers) {
-			return nil
+			return true, nil
 		}
 		log.Printf("failed to match all metrics: want %#v", s.Matchers)
-		time.Sleep(1 * time.Second)
+		return false, nil
+	})
+	if err == errPollTimeout {
+		return errors.New("failed to match all stats")
+	}
+	return err
+}
+
+func (s *Stats) adminPort(p *Params) (uint16, error) {
+	if s.AdminPortTemplate == "" {
+		return s.AdminPort, nil
+	}
+	filled, err := p.Fill(s.AdminPortTemplate)
+	if err != nil {
+		return 0, err
+	}
+	port, err := strconv.ParseUint(filled, 10, 16)
+	if err != nil {
+		return 0, fmt.Errorf("admin port %q: %v", filled, err)
+	}
+	return uint16(port), nil
+}
+
+func (s *Stats) filter() string {
+	if s.Filter != "" || len(s.Matchers) == 0 {
+		return s.Filter
+	}
+	names := make([]string, 0, len(s.Matchers))
+	for name := range s.Matchers {
+		if strings.HasPrefix(name, "envoy_") {
+			return ""
+		}
+		names = append(names, regexp.QuoteMeta(name))
+	}
+	sort.Strings(names)
+	return strings.Join(names, "|")
+}
+
+var errPollTimeout = errors.New("condition not met before timeout")
+
+// pollWithBackoff calls check until it reports done, returns an error, or
+// timeout elapses. The interval starts short, so that conditions which are
+// met almost immediately do not cost a full second, and doubles up to one
+// second so that slow ones do not hammer the admin endpoint.
+func pollWithBackoff(timeout time.Duration, check func() (bool, error)) error {
+	deadline := time.Now().Add(timeout)
+	interval := 20 * time.Millisecond
+	for {
+		done, err := check()
+		if err != nil || done {
+			return err
+		}
+		remaining := time.Until(deadline)
+		if remaining <= 0 {
+			return errPollTimeout
+		}
+		if interval > remaining {
+			interval = remaining
+		}
+		time.Sleep(interval)
+		if interval *= 2; interval > time.Second {
+			interval = time.Second
+		}
 	}
-	return errors.New("failed to match all stats")
 }
 
 func (s *Stats) Cleanup() {}
@@ -0,0 +1,62 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package framework
+
+import (
+	"errors"
+	"testing"
+	"time"
+)
+
+func TestPollWithBackoff(t *testing.T) {
+	calls := 0
+	err := pollWithBackoff(time.Second, func() (bool, error) {
+		calls++
+		return calls == 3, nil
+	})
+	if err != nil || calls != 3 {
+		t.Errorf("got error %v after %d calls, want done after 3", err, calls)
+	}
+
+	failure := errors.New("failure")
+	calls = 0
+	err = pollWithBackoff(time.Second, func() (bool, error) {
+		calls++
+		return false, failure
+	})
+	if err != failure || calls != 1 {
+		t.Errorf("got error %v after %d calls, want %v after 1", err, calls, failure)
+	}
+}
+
+func TestPollWithBackoffTimeout(t *testing.T) {
+	calls := 0
+	start := time.Now()
+	err := pollWithBackoff(200*time.Millisecond, func() (bool, error) {
+		calls++
+		return false, nil
+	})
+	elapsed := time.Since(start)
+	if err != errPollTimeout {
+		t.Errorf("got error %v, want %v", err, errPollTimeout)
+	}
+	// Intervals of 20, 40 and 80ms, then the remaining 60ms.
+	if calls < 3 || calls > 6 {
+		t.Errorf("got %d calls in 200ms, want backoff from 20ms", calls)
+	}
+	if elapsed < 200*time.Millisecond || elapsed > time.Second {
+		t.Errorf("timed out after %v, want 200ms", elapsed)
+	}
+}
@@ -0,0 +1,30 @@
+// Copyright 2020 Istio Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package testdata
+
+// CollectorCluster is a static cluster pointing to the stand-in collector
+// server. It can be passed as ClientStaticCluster or ServerStaticCluster.
+var CollectorCluster = `- name: collector
+  connect_timeout: 1s
+  type: STATIC
+  load_assignment:
+    cluster_name: collector
+    endpoints:
+    - lb_endpoints:
+      - endpoint:
+          address:
+            socket_address:
+              address: 127.0.0.1
+              port_value: {{ .Ports.CollectorPort }}`